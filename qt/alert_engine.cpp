@@ -0,0 +1,380 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <ostream>
+#include <utility>
+
+#include "alert_engine.h"
+#include "logger.h"
+#include "stock.h"
+#include "stock_registry.h"
+
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QString>
+#include <QStringList>
+
+#define DEBUG_TYPE "alert-engine"
+
+using Op = AlertInstr::Op;
+using Field = AlertInstr::Field;
+
+static constexpr std::array<std::pair<std::string_view, Field>, 7> kFields = {{
+    {"last", Field::kLast},
+    {"base", Field::kBase},
+    {"diff", Field::kDiff},
+    {"basis", Field::kDiff},
+    {"pct", Field::kPct},
+    {"high", Field::kHigh},
+    {"low", Field::kLow},
+}};
+
+namespace {
+// Recursive descent over the rule text, emitting postfix instructions.
+//   or  := and ("or" and)*
+//   and := cmp ("and" cmp)*
+//   cmp := "(" or ")" | value (">" | ">=" | "<" | "<=") value
+//   value := number | field | "velocity" "(" number ")"
+class RuleParser {
+public:
+  RuleParser(std::string_view text, std::vector<AlertInstr> &program)
+      : text(text), program(program) {}
+
+  bool parse(std::string &error) {
+    if (!parseOr())
+      return fail(error);
+    skipSpace();
+    if (pos != text.size()) {
+      this->error = "unexpected '" + std::string(text.substr(pos)) + "'";
+      return fail(error);
+    }
+    return true;
+  }
+  bool usesHistory() const { return needHistory; }
+
+private:
+  std::string_view text;
+  std::vector<AlertInstr> &program;
+  size_t pos = 0;
+  bool needHistory = false;
+  std::string error;
+
+  bool fail(std::string &out) {
+    out = error.empty() ? "invalid rule" : error;
+    return false;
+  }
+
+  void skipSpace() {
+    while (pos < text.size() && std::isspace(text[pos]))
+      pos++;
+  }
+
+  bool accept(std::string_view token) {
+    skipSpace();
+    if (!text.substr(pos).starts_with(token))
+      return false;
+    // Keywords must not run into an identifier
+    size_t end = pos + token.size();
+    if (std::isalpha(token.back()) && end < text.size() &&
+        (std::isalnum(text[end]) || text[end] == '_'))
+      return false;
+    pos = end;
+    return true;
+  }
+
+  std::string_view identifier() {
+    skipSpace();
+    size_t start = pos;
+    while (pos < text.size() && (std::isalpha(text[pos]) || text[pos] == '_'))
+      pos++;
+    return text.substr(start, pos - start);
+  }
+
+  bool number(double &out) {
+    skipSpace();
+    auto [ptr, ec] =
+        std::from_chars(text.data() + pos, text.data() + text.size(), out);
+    if (ec != std::errc())
+      return false;
+    pos = ptr - text.data();
+    return true;
+  }
+
+  void append(Op op, double value = 0.0, Field field = Field::kLast) {
+    program.push_back(AlertInstr{.op = op, .field = field, .value = value});
+  }
+
+  bool parseOr() {
+    if (!parseAnd())
+      return false;
+    while (accept("or")) {
+      if (!parseAnd())
+        return false;
+      append(Op::kOr);
+    }
+    return true;
+  }
+
+  bool parseAnd() {
+    if (!parseCmp())
+      return false;
+    while (accept("and")) {
+      if (!parseCmp())
+        return false;
+      append(Op::kAnd);
+    }
+    return true;
+  }
+
+  bool parseCmp() {
+    if (accept("(")) {
+      if (!parseOr())
+        return false;
+      if (!accept(")")) {
+        error = "missing ')'";
+        return false;
+      }
+      return true;
+    }
+    if (!parseValue())
+      return false;
+    Op op;
+    // Two character operators first
+    if (accept(">="))
+      op = Op::kGreaterEqual;
+    else if (accept("<="))
+      op = Op::kLessEqual;
+    else if (accept(">"))
+      op = Op::kGreater;
+    else if (accept("<"))
+      op = Op::kLess;
+    else {
+      error = "expected comparison (>, >=, <, <=)";
+      return false;
+    }
+    if (!parseValue())
+      return false;
+    append(op);
+    return true;
+  }
+
+  bool parseValue() {
+    double value;
+    if (number(value)) {
+      append(Op::kConst, value);
+      return true;
+    }
+    size_t start = pos;
+    auto name = identifier();
+    if (name == "velocity") {
+      if (!accept("(") || !number(value) || value <= 0 || !accept(")")) {
+        error = "expected velocity(minutes)";
+        return false;
+      }
+      needHistory = true;
+      append(Op::kVelocity, value);
+      return true;
+    }
+    for (const auto &[fieldName, field] : kFields) {
+      if (name == fieldName) {
+        append(Op::kField, 0.0, field);
+        return true;
+      }
+    }
+    pos = start;
+    error = "unknown value '" + std::string(name) + "'";
+    return false;
+  }
+};
+} // namespace
+
+std::optional<AlertRule> compileAlert(SymbolId id, std::string_view text,
+                                      std::string &error) {
+  AlertRule rule{.id = id,
+                 .text = std::string(text),
+                 .program = {},
+                 .hysteresis = 0.0,
+                 .command = {},
+                 .needHistory = false};
+  // Split the trailing "exec cmd" and "hyst h" off the expression
+  size_t execPos = text.find(" exec ");
+  if (execPos != std::string_view::npos) {
+    rule.command = std::string(text.substr(execPos + 6));
+    text = text.substr(0, execPos);
+  }
+  size_t hystPos = text.find(" hyst ");
+  if (hystPos != std::string_view::npos) {
+    auto hyst = text.substr(hystPos + 6);
+    auto [ptr, ec] = std::from_chars(hyst.data(), hyst.data() + hyst.size(),
+                                     rule.hysteresis);
+    if (ec != std::errc() || ptr != hyst.data() + hyst.size() ||
+        rule.hysteresis < 0) {
+      error = "invalid hysteresis '" + std::string(hyst) + "'";
+      return std::nullopt;
+    }
+    text = text.substr(0, hystPos);
+  }
+
+  RuleParser parser(text, rule.program);
+  if (!parser.parse(error))
+    return std::nullopt;
+  // Values push, comparisons and and/or pop two and push one
+  size_t depth = 0, maxDepth = 0;
+  for (const AlertInstr &instr : rule.program) {
+    bool push = instr.op == Op::kField || instr.op == Op::kConst ||
+                instr.op == Op::kVelocity;
+    depth = push ? depth + 1 : depth - 1;
+    maxDepth = std::max(maxDepth, depth);
+  }
+  if (maxDepth > kMaxAlertStack) {
+    error = "rule nests deeper than " + std::to_string(kMaxAlertStack) +
+            " values";
+    return std::nullopt;
+  }
+  rule.needHistory = parser.usesHistory();
+  return rule;
+}
+
+void AlertEngine::addRule(const AlertRule &rule) {
+  if (rule.id >= rulesOf.size())
+    rulesOf.resize(rule.id + 1);
+  rulesOf[rule.id].push_back(rules.size());
+  rules.push_back(Rule{.id = rule.id,
+                       .begin = static_cast<uint32_t>(code.size()),
+                       .end = static_cast<uint32_t>(code.size() +
+                                                    rule.program.size()),
+                       .hysteresis = rule.hysteresis,
+                       .needHistory = rule.needHistory,
+                       .fired = false,
+                       .text = rule.text,
+                       .command = rule.command});
+  code.insert(code.end(), rule.program.begin(), rule.program.end());
+}
+
+void AlertEngine::removeRules(SymbolId id) {
+  if (id >= rulesOf.size() || rulesOf[id].empty())
+    return;
+  // Every config reload that touches alerts lands here, compact the rest so
+  // dead rules and their bytecode don't pile up
+  std::erase_if(rules, [id](const Rule &rule) { return rule.id == id; });
+  std::vector<AlertInstr> kept;
+  kept.reserve(code.size());
+  for (Rule &rule : rules) {
+    uint32_t begin = static_cast<uint32_t>(kept.size());
+    kept.insert(kept.end(), code.begin() + rule.begin,
+                code.begin() + rule.end);
+    rule.begin = begin;
+    rule.end = static_cast<uint32_t>(kept.size());
+  }
+  code = std::move(kept);
+  for (auto &indices : rulesOf)
+    indices.clear();
+  for (uint32_t i = 0; i < rules.size(); i++)
+    rulesOf[rules[i].id].push_back(i);
+}
+
+// Percent change of the last price over the last ticks of the history
+static double velocity(const Data &history, size_t ticks) {
+  if (history.size() < 2)
+    return 0.0;
+  ticks = std::min(std::max<size_t>(ticks, 1), history.size() - 1);
+  double from = history[history.size() - 1 - ticks];
+  return from == 0.0 ? 0.0 : (history.back() - from) / from * 100.0;
+}
+
+void AlertEngine::evaluate(const StockRegistry &stocks,
+                           const std::vector<SymbolId> &changed) {
+  for (SymbolId id : changed) {
+    if (id >= rulesOf.size() || rulesOf[id].empty())
+      continue;
+    const Stock *stock = stocks.find(id);
+    if (!stock)
+      continue;
+    Quote quote = stocks.quotes().row(stocks.getSlot(id));
+    if (quote.isPending())
+      continue;
+    const double fields[static_cast<int>(Field::kNum)] = {
+        quote.last, quote.base, quote.diff, quote.pct, quote.high, quote.low};
+    std::optional<Data> history;
+
+    for (uint32_t idx : rulesOf[id]) {
+      Rule &rule = rules[idx];
+      if (rule.needHistory && !history)
+        history = stock->getHistroy();
+      // A fired rule stays true until it is false by more than hysteresis
+      double h = rule.fired ? rule.hysteresis : 0.0;
+      double stack[kMaxAlertStack];
+      size_t top = 0;
+      for (uint32_t pc = rule.begin; pc < rule.end; pc++) {
+        const AlertInstr &instr = code[pc];
+        switch (instr.op) {
+        case Op::kField:
+          stack[top++] = fields[static_cast<int>(instr.field)];
+          break;
+        case Op::kConst:
+          stack[top++] = instr.value;
+          break;
+        case Op::kVelocity:
+          stack[top++] = velocity(*history, instr.value * 60000 / freq);
+          break;
+        case Op::kGreater:
+          top--;
+          stack[top - 1] = stack[top - 1] > stack[top] - h;
+          break;
+        case Op::kGreaterEqual:
+          top--;
+          stack[top - 1] = stack[top - 1] >= stack[top] - h;
+          break;
+        case Op::kLess:
+          top--;
+          stack[top - 1] = stack[top - 1] < stack[top] + h;
+          break;
+        case Op::kLessEqual:
+          top--;
+          stack[top - 1] = stack[top - 1] <= stack[top] + h;
+          break;
+        case Op::kAnd:
+          top--;
+          stack[top - 1] = stack[top - 1] != 0.0 && stack[top] != 0.0;
+          break;
+        case Op::kOr:
+          top--;
+          stack[top - 1] = stack[top - 1] != 0.0 || stack[top] != 0.0;
+          break;
+        }
+      }
+      bool result = top == 1 && stack[0] != 0.0;
+      if (result && !rule.fired)
+        fire(rule, stock->getName(), quote.last);
+      rule.fired = result;
+    }
+  }
+}
+
+void AlertEngine::fire(const Rule &rule, const std::string &name,
+                       double price) const {
+  const auto &code = symbolCode(rule.id);
+  LOG(INFO) << "Alert " << code << "(" << name << "): " << rule.text
+            << ", price: " << price;
+  QString message = QString("%1 %2: %3, price %4")
+                        .arg(QString::fromStdString(code),
+                             QString::fromStdString(name),
+                             QString::fromStdString(rule.text))
+                        .arg(price, 0, 'f', 2);
+  // Detached, so a slow notifier never blocks the tick loop
+  if (rule.command.empty()) {
+    QProcess::startDetached("notify-send", {"Stock alert", message});
+    return;
+  }
+  QProcess process;
+  QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+  env.insert("MONITOR_CODE", QString::fromStdString(code));
+  env.insert("MONITOR_PRICE", QString::number(price, 'f', 3));
+  env.insert("MONITOR_RULE", QString::fromStdString(rule.text));
+  process.setProcessEnvironment(env);
+  process.setProgram("/bin/sh");
+  process.setArguments({"-c", QString::fromStdString(rule.command)});
+  if (!process.startDetached())
+    LOG(ERROR) << "Start alert command failed: " << rule.command;
+}
@@ -0,0 +1,105 @@
+#ifndef ALERT_ENGINE_H
+#define ALERT_ENGINE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "symbol_table.h"
+
+class StockRegistry;
+
+// One instruction of the postfix program of a rule.
+struct AlertInstr {
+  enum class Op : uint8_t {
+    kField,    // Push a quote field
+    kConst,    // Push value
+    kVelocity, // Push percent change over the last value minutes
+    kGreater,
+    kGreaterEqual,
+    kLess,
+    kLessEqual,
+    kAnd,
+    kOr,
+  };
+  enum class Field : uint8_t {
+    kLast = 0,
+    kBase,
+    kDiff, // Also "basis" of futures, whose base is the spot index
+    kPct,
+    kHigh,
+    kLow,
+    kNum,
+  };
+  Op op;
+  Field field;
+  double value;
+};
+
+// Deepest evaluation stack of a rule, compileAlert rejects deeper ones.
+constexpr size_t kMaxAlertStack = 32;
+
+// A rule compiled from the "alert:" section of the config file, e.g.
+//   sh600000 last > 10.5
+//   sh600000 pct <= -3 or velocity(5) >= 1 hyst 0.5
+//   IF-Front basis < -20 exec ~/bin/on_basis.sh
+// Comparisons combine with and/or and parentheses. "hyst h" sets the
+// hysteresis of every comparison: a fired rule re-arms only once it is false
+// by more than h. The action is a desktop notification unless "exec cmd" is
+// given.
+struct AlertRule {
+  SymbolId id;
+  std::string text;
+  std::vector<AlertInstr> program;
+  double hysteresis;
+  std::string command; // Empty for desktop notification
+  bool needHistory;    // Uses velocity()
+};
+
+// Compile "<rule> [hyst h] [exec cmd]", return std::nullopt and set error if
+// invalid.
+std::optional<AlertRule> compileAlert(SymbolId id, std::string_view text,
+                                      std::string &error);
+
+// Holds the bytecode of all rules in one flat array, indexed by symbol, and
+// evaluates only the rules of symbols that changed in a fetch cycle. Rules
+// are edge triggered: an action fires when its rule turns true.
+class AlertEngine {
+public:
+  // freq is the fetch interval, used to convert minutes to history ticks.
+  explicit AlertEngine(int64_t freq) { setFreq(freq); }
+  void setFreq(int64_t value) { freq = std::max<int64_t>(value, 1); }
+
+  void addRule(const AlertRule &rule);
+  // Drop all rules of a symbol, the others keep their state.
+  void removeRules(SymbolId id);
+  size_t size() const { return rules.size(); }
+
+  void evaluate(const StockRegistry &stocks,
+                const std::vector<SymbolId> &changed);
+
+private:
+  struct Rule {
+    SymbolId id;
+    uint32_t begin; // Program is code[begin, end)
+    uint32_t end;
+    double hysteresis;
+    bool needHistory;
+    bool fired;
+    std::string text;
+    std::string command;
+  };
+
+  int64_t freq;
+  std::vector<AlertInstr> code;
+  std::vector<Rule> rules;
+  std::vector<std::vector<uint32_t>> rulesOf; // Symbol id -> rule indices
+
+  void fire(const Rule &rule, const std::string &name, double price) const;
+};
+
+#endif // ALERT_ENGINE_H
@@ -2,59 +2,133 @@
 #include <cstddef>
 #include <exception>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "config_dialog.h"
+#include "symbol_master.h"
 #include "ui_config_dialog.h"
 #include "utils.h"
 
-#include <QInputDialog>
+#include <QCompleter>
+#include <QDialogButtonBox>
+#include <QLabel>
 #include <QLineEdit>
 #include <QList>
 #include <QListWidget>
 #include <QMessageBox>
+#include <QStringList>
+#include <QStringListModel>
+#include <QVBoxLayout>
+#include <QVariant>
 
 class QWidget;
-ConfigDialog::ConfigDialog(const StockSet &currentStocks, QWidget *parent)
+ConfigDialog::ConfigDialog(const StockRegistry &currentStocks,
+                           QWidget *parent)
     : QDialog(parent), ui(new Ui::ConfigDialog), originalStocks(currentStocks) {
   ui->setupUi(this);
   setWindowTitle("Configure Stock List");
 
-  // Extract original stock codes (for quick validation)
-  for (const auto &stock : originalStocks) {
-    originalCodes.insert(stock->getCode());
-  }
-
   // Initially display all original stocks
   refreshList();
 }
 
+// Completions shown while typing a code
+static constexpr size_t kCompletions = 20;
+
+// Name from the symbol master, "--" if unknown
+static std::string localName(const std::string &code) {
+  const SymbolMaster *master = SymbolMaster::instance();
+  std::string_view name = master ? master->name(code) : std::string_view();
+  return name.empty() ? "--" : std::string(name);
+}
+
 // Refresh list: original codes - deleted + added
 void ConfigDialog::refreshList() {
   ui->listWidget->clear();
   // Display original stocks (not marked for deletion)
-  for (const auto &stock : originalStocks) {
-    std::string code = stock->getCode();
-    if (!deletedCodes.count(code)) {
-      // Get name directly from Stock object, show "--" if empty
-      std::string name = stock->getName().empty() ? "--" : stock->getName();
-      ui->listWidget->addItem(QString::fromStdString(code + " " + name));
+  for (size_t i = 0; i < originalStocks.size(); i++) {
+    const Stock &stock = originalStocks.at(i);
+    if (!deletedCodes.count(stock.getId())) {
+      // Get name from Stock object, from the symbol master while pending
+      std::string name = stock.getName().empty() ? localName(stock.getCode())
+                                                 : stock.getName();
+      addItem(stock.getId(), stock.getCode() + " " + name);
     }
   }
-  // Display added stocks (fixed name as "--")
-  for (const auto &code : addedCodes) {
-    ui->listWidget->addItem(QString::fromStdString(code + " -- (new)"));
+  // Display added stocks, named without fetching
+  for (const auto &id : addedCodes) {
+    addItem(id, symbolCode(id) + " " + localName(symbolCode(id)) + " (new)");
   }
 }
 
+// The item keeps the symbol id, so removal never parses the text
+void ConfigDialog::addItem(SymbolId id, const std::string &text) {
+  auto *item = new QListWidgetItem(QString::fromStdString(text));
+  item->setData(Qt::UserRole, static_cast<uint>(id));
+  ui->listWidget->addItem(item);
+}
+
+// Ask for a code, completed from the symbol master on each keystroke by
+// code, digits, pinyin initials or name. Return an empty string if canceled.
+std::string ConfigDialog::askCode() {
+  QDialog dialog(this);
+  dialog.setWindowTitle("Add Stock");
+  auto *layout = new QVBoxLayout(&dialog);
+  layout->addWidget(new QLabel("Please enter stock code, name or pinyin "
+                               "initials (e.g., sh600000, 600000, pfyh):",
+                               &dialog));
+  auto *edit = new QLineEdit(&dialog);
+  layout->addWidget(edit);
+  auto *buttons = new QDialogButtonBox(
+      QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+  layout->addWidget(buttons);
+  connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+  connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+  const SymbolMaster *master = SymbolMaster::instance();
+  if (master) {
+    auto *model = new QStringListModel(&dialog);
+    auto *completer = new QCompleter(model, &dialog);
+    // The model holds the matches already, shown as they are
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    edit->setCompleter(completer);
+    connect(edit, &QLineEdit::textEdited, [=](const QString &text) {
+      QStringList items;
+      for (const auto &symbol :
+           master->search(text.trimmed().toStdString(), kCompletions))
+        items << QString::fromStdString(std::string(symbol.code) + " " +
+                                        std::string(symbol.name));
+      model->setStringList(items);
+      completer->complete();
+    });
+  }
+  if (dialog.exec() != QDialog::Accepted)
+    return {};
+
+  // A completion is "<code> <name>"
+  std::string text = edit->text().trimmed().toStdString();
+  std::string code = text.substr(0, text.find(' '));
+  if (master && !code.empty()) {
+    // Initials or a name typed without picking take the best match
+    bool valid = true;
+    try {
+      checkCode(code);
+    } catch (const std::exception &e) {
+      valid = false;
+    }
+    auto matches = valid ? std::vector<SymbolInfo>() : master->search(code, 1);
+    if (!matches.empty())
+      code = matches.front().code;
+  }
+  return code;
+}
+
 // Add stock (record to addedCodes, check for duplicates)
 void ConfigDialog::on_addButton_clicked() {
-  bool ok;
-  QString code = QInputDialog::getText(
-      this, "Add Stock",
-      "Please enter stock code (format: sh600000 or sz000000):",
-      QLineEdit::Normal, "", &ok);
-  if (ok && !code.isEmpty()) {
-    std::string codeStr = code.trimmed().toStdString();
+  std::string codeStr = askCode();
+  if (!codeStr.empty()) {
     try {
       checkCode(codeStr);
     } catch (const std::exception &e) {
@@ -64,9 +138,10 @@ void ConfigDialog::on_addButton_clicked() {
     }
 
     // Duplication check (existing stocks or already added)
-    bool isDuplicate = originalCodes.count(codeStr);
+    SymbolId id = internSymbol(codeStr);
+    bool isDuplicate = originalStocks.find(id) != nullptr;
     if (!isDuplicate) {
-      isDuplicate = std::find(addedCodes.begin(), addedCodes.end(), codeStr) !=
+      isDuplicate = std::find(addedCodes.begin(), addedCodes.end(), id) !=
                     addedCodes.end();
     }
     if (isDuplicate) {
@@ -75,7 +150,7 @@ void ConfigDialog::on_addButton_clicked() {
     }
 
     // Validation passed, add the stock
-    addedCodes.push_back(codeStr);
+    addedCodes.push_back(id);
     refreshList();
   }
 }
@@ -90,24 +165,16 @@ void ConfigDialog::on_removeButton_clicked() {
   }
 
   for (auto item : selected) {
-    QString text = item->text();
-    std::string itemStr = text.toStdString();
-    bool isAdded = itemStr.find("(new)") != std::string::npos;
-
-    // Extract stock code (format: "code name" or "code -- (new)")
-    std::string code;
-    size_t firstSpace = itemStr.find(' ');
-    if (firstSpace != std::string::npos) {
-      code = itemStr.substr(0, firstSpace);
-    }
+    SymbolId id = item->data(Qt::UserRole).toUInt();
+    bool isAdded = originalStocks.find(id) == nullptr;
 
     if (isAdded) {
       // Remove from added list
-      auto it = std::remove(addedCodes.begin(), addedCodes.end(), code);
+      auto it = std::remove(addedCodes.begin(), addedCodes.end(), id);
       addedCodes.erase(it, addedCodes.end());
     } else {
       // Mark original stock for deletion
-      deletedCodes.insert(code);
+      deletedCodes.insert(id);
     }
     delete item;
   }
@@ -6,7 +6,8 @@
 #include <string>
 #include <vector>
 
-#include "stock.h"
+#include "stock_registry.h"
+#include "symbol_table.h"
 
 #include <QMetaObject>
 #include <QString>
@@ -23,11 +24,11 @@ QT_END_NAMESPACE
 class ConfigDialog : public QDialog {
   Q_OBJECT
 public:
-  ConfigDialog(const StockSet &currentStocks, QWidget *parent = nullptr);
+  ConfigDialog(const StockRegistry &currentStocks, QWidget *parent = nullptr);
   virtual ~ConfigDialog() = default;
 
-  std::set<std::string> getDeletedCodes() const { return deletedCodes; }
-  std::vector<std::string> getAddedCodes() const { return addedCodes; }
+  std::set<SymbolId> getDeletedCodes() const { return deletedCodes; }
+  std::vector<SymbolId> getAddedCodes() const { return addedCodes; }
 
 private slots:
   void on_addButton_clicked();
@@ -36,11 +37,12 @@ private slots:
 
 private:
   Ui::ConfigDialog *ui;
-  const StockSet &originalStocks;      // Original Stocks(read only)
-  std::set<std::string> originalCodes; // Original stock code.
-  std::set<std::string> deletedCodes;  // Record deleted stock code.
-  std::vector<std::string> addedCodes; // Record added stock code.
+  const StockRegistry &originalStocks; // Original Stocks(read only)
+  std::set<SymbolId> deletedCodes;  // Record deleted stock code.
+  std::vector<SymbolId> addedCodes; // Record added stock code.
 
   void refreshList();
+  std::string askCode();
+  void addItem(SymbolId id, const std::string &text);
 };
 #endif // CONFIG_DIALOG_H
@@ -1,9 +1,18 @@
 #include <algorithm>
+#include <charconv>
 #include <cstddef>
+#include <optional>
+#include <set>
+#include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
+#include "alert_engine.h"
 #include "config_parser.h"
+#include "indicator.h"
 #include "logger.h"
+#include "utils.h"
 
 #define DEBUG_TYPE "config-parser"
 
@@ -64,7 +73,50 @@ static int64_t parseTime(std::string_view time_sv) {
   }
 }
 
-static void removeDuplicates(std::vector<std::string> &vec) {
+// A code range, "test[0-4999]" stands for test0 to test4999.
+struct CodeRange {
+  std::string_view prefix;
+  int64_t first;
+  int64_t last;
+  std::string code(int64_t i) const {
+    return std::string(prefix) + std::to_string(i);
+  }
+};
+
+// Range of code, nullopt if code is not one or the range is invalid.
+static std::optional<CodeRange> parseRange(std::string_view code) {
+  constexpr int64_t kMaxRange = 100000;
+  size_t open = code.find('[');
+  if (open == std::string_view::npos || !code.ends_with(']'))
+    return std::nullopt;
+  std::string_view range = code.substr(open + 1, code.size() - open - 2);
+  size_t dash = range.find('-');
+  int64_t first = -1, last = -1;
+  if (dash != std::string_view::npos) {
+    std::from_chars(range.data(), range.data() + dash, first);
+    std::from_chars(range.data() + dash + 1, range.data() + range.size(),
+                    last);
+  }
+  if (first < 0 || last < first || last - first >= kMaxRange)
+    return std::nullopt;
+  return CodeRange{code.substr(0, open), first, last};
+}
+
+// Codes of a range, for simulated load, other codes as they are. Empty if
+// the range is invalid.
+static std::vector<std::string> expandCodes(std::string_view code) {
+  if (code.find('[') == std::string_view::npos)
+    return {std::string(code)};
+  auto range = parseRange(code);
+  if (!range)
+    return {};
+  std::vector<std::string> codes;
+  for (int64_t i = range->first; i <= range->last; i++)
+    codes.push_back(range->code(i));
+  return codes;
+}
+
+static void removeDuplicates(std::vector<SymbolId> &vec) {
   std::sort(vec.begin(), vec.end());
   auto last = std::unique(vec.begin(), vec.end());
   vec.erase(last, vec.end());
@@ -74,9 +126,10 @@ std::optional<ConfigData> parseConfig(std::istream &ins) {
   ConfigData result;
   result.codes.clear();
   enum class State {
-    INIT,      // Wait "code:" or "freq:"
-    READ_CODE, // Read content after "code:"
-    READ_FREQ  // Read content after "freq:"
+    INIT,       // Wait "code:", "freq:" or "alert:"
+    READ_CODE,  // Read content after "code:"
+    READ_FREQ,  // Read content after "freq:"
+    READ_ALERT, // Read content after "alert:"
   } state = State::INIT;
 
   std::string line;
@@ -98,9 +151,12 @@ std::optional<ConfigData> parseConfig(std::istream &ins) {
         state = State::READ_CODE;
       } else if (trimmed == "freq:") {
         state = State::READ_FREQ;
+      } else if (trimmed == "alert:") {
+        state = State::READ_ALERT;
       } else {
         LOG(ERROR) << "Parse config failed(line: " << line_num
-                   << "), unexpected content, expected 'code:' or 'freq:'";
+                   << "), unexpected content, expected 'code:', 'freq:' or "
+                      "'alert:'";
         return std::nullopt;
       }
       break;
@@ -108,12 +164,69 @@ std::optional<ConfigData> parseConfig(std::istream &ins) {
     case State::READ_CODE:
       if (trimmed == "freq:") {
         state = State::READ_FREQ;
+      } else if (trimmed == "alert:") {
+        state = State::READ_ALERT;
       } else {
         DBG() << "parse code: " << trimmed;
-        result.codes.emplace_back(trimmed);
+        auto fields = splitString(trimmed, ' ');
+        auto codes = expandCodes(fields[0]);
+        if (codes.empty()) {
+          LOG(ERROR) << "Parse config failed(line: " << line_num
+                     << "), invalid code range '" << fields[0]
+                     << "' (e.g., 'test[0-4999]')";
+          return std::nullopt;
+        }
+        std::vector<IndicatorSpec> specs;
+        for (size_t i = 1; i < fields.size(); i++) {
+          if (fields[i].empty())
+            continue;
+          auto spec = parseIndicator(fields[i]);
+          if (!spec) {
+            LOG(ERROR) << "Parse config failed(line: " << line_num
+                       << "), invalid indicator '" << fields[i]
+                       << "' (e.g., 'ma:20', 'ema:12', 'vwap', 'boll:20:2', "
+                          "'rsi:14')";
+            return std::nullopt;
+          }
+          specs.push_back(*spec);
+        }
+        for (const auto &code : codes) {
+          SymbolId id = internSymbol(code);
+          result.codes.push_back(id);
+          if (!specs.empty())
+            result.indicators[id] = specs;
+        }
       }
       break;
 
+    case State::READ_ALERT: {
+      if (trimmed == "code:") {
+        state = State::READ_CODE;
+        break;
+      } else if (trimmed == "freq:") {
+        state = State::READ_FREQ;
+        break;
+      }
+      DBG() << "parse alert: " << trimmed;
+      size_t split = trimmed.find(' ');
+      if (split == std::string_view::npos) {
+        LOG(ERROR) << "Parse config failed(line: " << line_num
+                   << "), expected '<code> <rule>' (e.g., 'sh600000 last > "
+                      "10.5')";
+        return std::nullopt;
+      }
+      std::string error;
+      auto rule = compileAlert(internSymbol(trimmed.substr(0, split)),
+                               trim(trimmed.substr(split)), error);
+      if (!rule) {
+        LOG(ERROR) << "Parse config failed(line: " << line_num
+                   << "), invalid alert: " << error;
+        return std::nullopt;
+      }
+      result.alerts.push_back(std::move(*rule));
+      break;
+    }
+
     case State::READ_FREQ:
       DBG() << "parse freq: " << trimmed;
       int64_t time = parseTime(trimmed);
@@ -122,6 +235,11 @@ std::optional<ConfigData> parseConfig(std::istream &ins) {
                    << "), invalid time format (e.g., '1ms' or '1s' or '1m')";
         return std::nullopt;
       }
+      if (time == 0) {
+        LOG(ERROR) << "Parse config failed(line: " << line_num
+                   << "), freq must be positive";
+        return std::nullopt;
+      }
       result.freq = time;
       state = State::INIT;
       break;
@@ -143,3 +261,98 @@ std::optional<ConfigData> parseConfig(std::istream &ins) {
   removeDuplicates(result.codes);
   return result;
 }
+
+// Append a line of the input, with the newline the last one may lack.
+static void appendLine(std::string &out, std::string_view line) {
+  out.append(line);
+  if (line.empty() || line.back() != '\n')
+    out += '\n';
+}
+
+// Append the line of a range without its removed codes, split into the
+// ranges left; rest follows the code, e.g. its indicators.
+static void appendRangeLine(
+    std::string &out, std::string_view indent, const CodeRange &range,
+    std::string_view rest,
+    const std::set<std::string_view, std::less<>> &removed) {
+  auto appendRun = [&](int64_t first, int64_t last) {
+    out.append(indent).append(range.prefix);
+    if (first == last)
+      out.append(std::to_string(first));
+    else
+      out.append("[" + std::to_string(first) + "-" + std::to_string(last) +
+                 "]");
+    out.append(rest).append("\n");
+  };
+  int64_t runStart = -1;
+  for (int64_t i = range.first; i <= range.last; i++) {
+    bool kept = !removed.count(range.code(i));
+    if (kept && runStart < 0)
+      runStart = i;
+    if (!kept && runStart >= 0) {
+      appendRun(runStart, i - 1);
+      runStart = -1;
+    }
+  }
+  if (runStart >= 0)
+    appendRun(runStart, range.last);
+}
+
+std::string editConfigCodes(std::string_view text,
+                            const std::set<SymbolId> &removed,
+                            const std::vector<SymbolId> &added) {
+  // Lines are matched by text, interning them would add ranges and typos
+  // to the symbol table
+  std::set<std::string_view, std::less<>> removedCodes;
+  for (SymbolId id : removed)
+    removedCodes.insert(symbolCode(id));
+  std::string result;
+  result.reserve(text.size() + added.size() * 16);
+  size_t insertAt = std::string::npos; // After the last code line
+  std::string_view indent = "  ";
+  bool inCode = false;
+
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    end = end == std::string_view::npos ? text.size() : end + 1;
+    std::string_view line = text.substr(pos, end - pos);
+    std::string_view trimmed = trim(line);
+    pos = end;
+
+    if (trimmed == "code:" || trimmed == "freq:" || trimmed == "alert:") {
+      inCode = trimmed == "code:";
+      appendLine(result, line);
+      if (inCode)
+        insertAt = result.size();
+    } else if (inCode && !trimmed.empty() && !isComment(trimmed)) {
+      std::string_view code = splitString(trimmed, ' ')[0];
+      if (removedCodes.count(code))
+        continue;
+      indent = line.substr(0, line.find_first_not_of(" \t"));
+      auto range = parseRange(code);
+      bool split = false;
+      if (range && !removedCodes.empty()) {
+        for (int64_t i = range->first; i <= range->last && !split; i++)
+          split = removedCodes.count(range->code(i));
+      }
+      if (split)
+        appendRangeLine(result, indent, *range, trimmed.substr(code.size()),
+                        removedCodes);
+      else
+        appendLine(result, line);
+      insertAt = result.size();
+    } else {
+      appendLine(result, line);
+    }
+  }
+
+  std::string lines;
+  for (SymbolId id : added)
+    lines.append(indent).append(symbolCode(id)).append("\n");
+  if (insertAt != std::string::npos)
+    result.insert(insertAt, lines);
+  else if (!added.empty())
+    result.append(result.empty() ? "" : "\n").append("code:\n").append(lines);
+  return result;
+}
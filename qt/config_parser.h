@@ -4,15 +4,35 @@
 #include <cstdint>
 #include <istream>
 #include <optional>
+#include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include "alert_engine.h"
+#include "indicator.h"
+#include "symbol_table.h"
+
 class ConfigData {
 public:
-  ConfigData() : freq(60000), codes({"sh000001"}) {}
+  ConfigData() : freq(60000), codes({internSymbol("sh000001")}) {}
   int64_t freq;
-  std::vector<std::string> codes;
+  std::vector<SymbolId> codes;
+  // Chart overlays of each code, written after the code, e.g.
+  // "sh600000 ma:20 boll:20:2"
+  std::unordered_map<SymbolId, std::vector<IndicatorSpec>> indicators;
+  // Rules of the "alert:" section, one "<code> <rule>" per line
+  std::vector<AlertRule> alerts;
 };
 
 std::optional<ConfigData> parseConfig(std::istream &ins);
+
+// Apply a watchlist edit to the text of a config file: lines of removed codes
+// are dropped, ranges holding one are split around it, and added codes
+// follow the last code line. Everything else, comments included, is kept as
+// written.
+std::string editConfigCodes(std::string_view text,
+                            const std::set<SymbolId> &removed,
+                            const std::vector<SymbolId> &added);
 #endif // CONFIG_PARSER_H
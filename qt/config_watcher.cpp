@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "alert_engine.h"
+#include "config_watcher.h"
+#include "indicator.h"
+#include "logger.h"
+#include "stock_fetcher.h"
+#include "stock_registry.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QSaveFile>
+#include <QStringList>
+
+#define DEBUG_TYPE "config-watcher"
+
+static const std::vector<IndicatorSpec> &indicatorsOf(const ConfigData &config,
+                                                      SymbolId id) {
+  static const std::vector<IndicatorSpec> none;
+  auto it = config.indicators.find(id);
+  return it == config.indicators.end() ? none : it->second;
+}
+
+// Rule texts of each code, in config order.
+static std::map<SymbolId, std::vector<std::string_view>>
+rulesByCode(const ConfigData &config) {
+  std::map<SymbolId, std::vector<std::string_view>> rules;
+  for (const auto &rule : config.alerts)
+    rules[rule.id].push_back(rule.text);
+  return rules;
+}
+
+ConfigDiff diffConfig(const ConfigData &from, const ConfigData &to) {
+  ConfigDiff diff;
+  // Codes are sorted by parseConfig
+  std::set_difference(from.codes.begin(), from.codes.end(), to.codes.begin(),
+                      to.codes.end(), std::back_inserter(diff.removed));
+  std::set_difference(to.codes.begin(), to.codes.end(), from.codes.begin(),
+                      from.codes.end(), std::back_inserter(diff.added));
+  for (SymbolId id : to.codes)
+    if (std::binary_search(from.codes.begin(), from.codes.end(), id) &&
+        indicatorsOf(from, id) != indicatorsOf(to, id))
+      diff.indicators.push_back(id);
+
+  auto fromRules = rulesByCode(from), toRules = rulesByCode(to);
+  for (const auto &[id, rules] : fromRules) {
+    auto it = toRules.find(id);
+    if (it == toRules.end() || it->second != rules)
+      diff.alerts.push_back(id);
+  }
+  for (const auto &[id, rules] : toRules)
+    if (!fromRules.count(id))
+      diff.alerts.push_back(id);
+
+  diff.freq = from.freq != to.freq;
+  return diff;
+}
+
+void applyConfig(const ConfigDiff &diff, const ConfigData &to,
+                 StockRegistry &stocks, AlertEngine &alerts) {
+  for (SymbolId id : diff.removed)
+    stocks.erase(id);
+  for (SymbolId id : diff.added) {
+    stocks.insert(id);
+    const auto &specs = indicatorsOf(to, id);
+    if (!specs.empty())
+      stocks.find(id)->setIndicators(specs);
+  }
+  // Replays the history, the chart keeps its ticks
+  for (SymbolId id : diff.indicators)
+    stocks.find(id)->setIndicators(indicatorsOf(to, id));
+  for (SymbolId id : diff.alerts) {
+    alerts.removeRules(id);
+    for (const auto &rule : to.alerts)
+      if (rule.id == id)
+        alerts.addRule(rule);
+  }
+  if (diff.freq) {
+    alerts.setFreq(to.freq);
+    NetworkFetcher::setFreq(to.freq);
+  }
+  LOG(INFO) << "Config reloaded: " << diff.added.size() << " codes added, "
+            << diff.removed.size() << " removed, " << diff.indicators.size()
+            << " with new indicators, " << diff.alerts.size()
+            << " with new alerts";
+}
+
+ConfigWatcher::ConfigWatcher(const QString &path,
+                             std::function<void(ConfigData)> onChange)
+    : path(path), onChange(std::move(onChange)) {
+  watcher.addPath(path);
+  watcher.addPath(QFileInfo(path).absolutePath());
+  settleTimer.setSingleShot(true);
+  QObject::connect(&settleTimer, &QTimer::timeout, [this]() { reload(); });
+  QObject::connect(&watcher, &QFileSystemWatcher::fileChanged,
+                   [this]() { settleTimer.start(settleInterval); });
+  // Any file of the directory, only matters once ours is back
+  QObject::connect(&watcher, &QFileSystemWatcher::directoryChanged,
+                   [this]() {
+                     if (!watcher.files().contains(this->path) &&
+                         QFileInfo::exists(this->path))
+                       settleTimer.start(settleInterval);
+                   });
+}
+
+void ConfigWatcher::reload() {
+  if (!watcher.files().contains(path))
+    watcher.addPath(path);
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    DBG() << "config " << path.toStdString() << " is gone";
+    return;
+  }
+  QByteArray data = file.readAll();
+  std::istringstream in(std::string(data.constData(), data.size()));
+  auto config = parseConfig(in);
+  if (!config) {
+    LOG(WARNING) << "Config " << path.toStdString()
+                 << " is invalid, keep the last one";
+    return;
+  }
+  onChange(std::move(*config));
+}
+
+bool ConfigWatcher::saveCodes(const std::set<SymbolId> &removed,
+                              const std::vector<SymbolId> &added) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    LOG(ERROR) << "Read config " << path.toStdString() << " failed";
+    return false;
+  }
+  QByteArray data = file.readAll();
+  file.close();
+  std::string text = editConfigCodes(
+      std::string_view(data.constData(), data.size()), removed, added);
+
+  // Written next to the file, renamed over it by commit()
+  QSaveFile out(path);
+  if (!out.open(QIODevice::WriteOnly) ||
+      out.write(text.data(), text.size()) != qint64(text.size()) ||
+      !out.commit()) {
+    LOG(ERROR) << "Save config " << path.toStdString()
+               << " failed: " << out.errorString().toStdString();
+    return false;
+  }
+  return true;
+}
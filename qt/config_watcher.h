@@ -0,0 +1,66 @@
+#ifndef CONFIG_WATCHER_H
+#define CONFIG_WATCHER_H
+
+#include <functional>
+#include <set>
+#include <vector>
+
+#include "config_parser.h"
+#include "symbol_table.h"
+
+#include <QFileSystemWatcher>
+#include <QString>
+#include <QTimer>
+
+class AlertEngine;
+class StockRegistry;
+
+// Difference between two parses of the config file.
+struct ConfigDiff {
+  std::vector<SymbolId> removed; // Codes no longer watched
+  std::vector<SymbolId> added;
+  std::vector<SymbolId> indicators; // Kept codes whose overlays changed
+  std::vector<SymbolId> alerts;     // Codes whose rules changed
+  bool freq = false;
+
+  bool watchlist() const { return !removed.empty() || !added.empty(); }
+  bool empty() const {
+    return !watchlist() && indicators.empty() && alerts.empty() && !freq;
+  }
+};
+
+ConfigDiff diffConfig(const ConfigData &from, const ConfigData &to);
+// Bring the live watchlist from the config it was built from to to. Only
+// the stocks in diff are touched, the others keep their history.
+void applyConfig(const ConfigDiff &diff, const ConfigData &to,
+                 StockRegistry &stocks, AlertEngine &alerts);
+
+// Re-parses the config file whenever it changes on disk. Editors often save
+// by renaming a new file over the old one, which drops it from the watch, so
+// the directory is watched too and the file re-added.
+class ConfigWatcher {
+public:
+  // onChange gets each valid parse, an invalid file keeps the last one.
+  ConfigWatcher(const QString &path,
+                std::function<void(ConfigData)> onChange);
+  ConfigWatcher(const ConfigWatcher &) = delete;
+  ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+
+  // Write a watchlist edit back to the file. The text goes to a temp file
+  // that is renamed over it, so a crash never leaves half a config.
+  bool saveCodes(const std::set<SymbolId> &removed,
+                 const std::vector<SymbolId> &added);
+
+private:
+  // Saves come in bursts of events, wait for the last one
+  static constexpr int settleInterval = 200; // ms
+
+  QString path;
+  QFileSystemWatcher watcher;
+  QTimer settleTimer;
+  std::function<void(ConfigData)> onChange;
+
+  void reload();
+};
+
+#endif // CONFIG_WATCHER_H
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "contract_calendar.h"
+
+#include <QDateTime>
+#include <QTime>
+#include <QTimeZone>
+
+namespace {
+
+struct Product {
+  std::string_view name;
+  QDate launch;
+};
+
+const std::array<Product, 4> kProducts{{
+    {"IF", QDate(2010, 4, 16)},
+    {"IH", QDate(2015, 4, 16)},
+    {"IC", QDate(2015, 4, 16)},
+    {"IM", QDate(2022, 7, 22)},
+}};
+
+constexpr int kFirstYear = 2010;
+constexpr int kLastYear = 2100;
+
+bool isQuarter(int month) { return month % 3 == 0; }
+
+QDate thirdFriday(int year, int month) {
+  QDate first(year, month, 1);
+  int toFriday = (Qt::Friday - first.dayOfWeek() + 7) % 7;
+  return first.addDays(toFriday + 14);
+}
+
+} // namespace
+
+const ContractCalendar &ContractCalendar::instance() {
+  static const ContractCalendar *calendar = new ContractCalendar;
+  return *calendar;
+}
+
+ContractCalendar::ContractCalendar() {
+  // Days end at midnight on the exchange, wherever the host is
+  const QTimeZone exchange("Asia/Shanghai");
+  months.reserve((kLastYear - kFirstYear + 1) * 12);
+  for (int year = kFirstYear; year <= kLastYear; year++) {
+    for (int month = 1; month <= 12; month++) {
+      QDate expiry = thirdFriday(year, month);
+      QDateTime end(expiry.addDays(1), QTime(0, 0), exchange);
+      months.push_back(
+          {year, month, QDate(), expiry, end.toMSecsSinceEpoch()});
+    }
+  }
+  // A month first trades as the next month, a quarter month as the second
+  // quarter after the next month, seven months before. Listed the Monday
+  // after the expiry of the month before that.
+  for (size_t i = 0; i < months.size(); i++) {
+    size_t before = isQuarter(months[i].month) ? 8 : 2;
+    if (i >= before)
+      months[i].listed = months[i - before].expiry.addDays(3);
+    else
+      months[i].listed = QDate(kFirstYear, 1, 1);
+  }
+}
+
+ContractCalendar::Contract ContractCalendar::resolve(std::string_view product,
+                                                     Slot slot,
+                                                     int64_t time) const {
+  auto it = std::find_if(kProducts.begin(), kProducts.end(),
+                         [product](const Product &p) {
+                           return p.name == product;
+                         });
+  if (it == kProducts.end())
+    throw std::invalid_argument(
+        std::string("Unknown future product: ").append(product));
+  // The current month is the first whose expiry day has not passed
+  auto current = std::upper_bound(
+      months.begin(), months.end(), time,
+      [](int64_t t, const Month &month) { return t < month.end; });
+  size_t index = current - months.begin();
+  auto quarterFrom = [this](size_t i) {
+    while (i < months.size() && !isQuarter(months[i].month))
+      i++;
+    return i;
+  };
+  size_t quarter = quarterFrom(index);
+  // Far quarters start after the next month, never repeating a month slot
+  size_t far = quarterFrom(index + 2);
+  size_t target = index;
+  switch (slot) {
+  case Slot::kMonth:
+    target = index;
+    break;
+  case Slot::kNextMonth:
+    target = index + 1;
+    break;
+  case Slot::kQuarter:
+    target = quarter;
+    break;
+  case Slot::kNextQuarter:
+    target = quarter + 3;
+    break;
+  case Slot::kFarQuarter:
+    target = far;
+    break;
+  case Slot::kNextFarQuarter:
+    target = far + 3;
+    break;
+  }
+  if (target >= months.size())
+    throw std::out_of_range("Contract calendar ends in " +
+                            std::to_string(kLastYear));
+
+  const Month &month = months[target];
+  char code[16];
+  snprintf(code, sizeof(code), "%.*s%02d%02d", int(product.size()),
+           product.data(), month.year % 100, month.month);
+  // Nearest quarter slots move with their quarter, the others with the
+  // current month
+  bool nearest = slot == Slot::kQuarter || slot == Slot::kNextQuarter;
+  int64_t rollAt = months[nearest ? quarter : index].end;
+  return Contract{.code = code,
+                  .listed = std::max(month.listed, it->launch),
+                  .expiry = month.expiry,
+                  .rollAt = rollAt};
+}
@@ -0,0 +1,58 @@
+#ifndef CONTRACT_CALENDAR_H
+#define CONTRACT_CALENDAR_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <QDate>
+
+// Contracts of the CFFEX equity index futures IH, IF, IC and IM. At any time
+// four trade: the current and next month and the two quarter months after
+// them, the month and far quarter slots. The nearest quarter slots may
+// repeat a month slot, they keep what -Front and -Next always meant. A
+// contract trades until the third Friday of its month, the Monday after it
+// the next one is listed. Dates of every month from the launch of
+// IF on are computed once, so resolving a contract is a binary search and
+// rolls are known in advance. Holidays are not known, an expiry they move
+// is taken a few days early.
+class ContractCalendar {
+public:
+  enum class Slot : int {
+    kMonth = 0,          // Current month
+    kNextMonth = 1,      // Next month
+    kQuarter = 2,        // Nearest quarter month not expired
+    kNextQuarter = 3,    // The quarter after it
+    kFarQuarter = 4,     // First quarter month after the next month
+    kNextFarQuarter = 5, // The quarter after it
+  };
+
+  struct Contract {
+    std::string code; // e.g. "IF2606"
+    QDate listed;
+    QDate expiry;
+    int64_t rollAt; // ms since epoch the slot moves to another contract
+  };
+
+  static const ContractCalendar &instance();
+
+  // Contract of product, e.g. "IF", in slot at time ms since epoch. Throws
+  // std::invalid_argument for an unknown product, std::out_of_range past
+  // the end of the calendar.
+  Contract resolve(std::string_view product, Slot slot, int64_t time) const;
+
+private:
+  struct Month {
+    int year;
+    int month;
+    QDate listed; // Ignoring product launches
+    QDate expiry;
+    int64_t end; // ms since epoch of the day after expiry
+  };
+  std::vector<Month> months; // Ascending, consecutive
+
+  ContractCalendar();
+};
+
+#endif // CONTRACT_CALENDAR_H
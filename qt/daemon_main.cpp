@@ -0,0 +1,51 @@
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "config_parser.h"
+#include "metrics_server.h"
+#include "logger.h"
+#include "quote_daemon.h"
+#include "quote_protocol.h"
+#include "utils.h"
+
+#include <QCoreApplication>
+
+// Quote daemon, fetches for every local client. Only freq of the config is
+// used, clients subscribe their own codes. With MONITOR_SHM set the codes of
+// the config are also written to the shared-memory quote bus it names.
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  ConfigData config;
+
+  if (argc == 2) {
+    std::ifstream fin(argv[1]);
+    auto configIn = parseConfig(fin);
+    if (configIn.has_value())
+      config = *configIn;
+  }
+  std::string serverName = defaultQuoteServer;
+  try {
+    auto name = getenv<std::string>("MONITOR_DAEMON");
+    if (!name.empty())
+      serverName = name;
+  } catch (const std::unset_env &e) {
+  }
+  QuoteDaemon daemon(config.freq);
+  if (!daemon.listen(serverName))
+    return 1;
+  startMetricsServer();
+  try {
+    auto name = getenv<std::string>("MONITOR_SHM");
+    daemon.publishTo(std::make_unique<QuoteBusWriter>(
+                         name.empty() ? defaultQuoteServer : name),
+                     config.codes);
+  } catch (const std::unset_env &e) {
+  } catch (const std::runtime_error &e) {
+    LOG(ERROR) << e.what();
+  }
+
+  return app.exec();
+}
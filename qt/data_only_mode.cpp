@@ -1,19 +1,26 @@
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "display_mode.h"
+#include "quote_table.h"
 #include "stock.h"
+#include "stock_registry.h"
+#include "text_cache.h"
+#include "trace.h"
+#include "utils.h"
 
 #include <QColor>
-#include <QFont>
 #include <QFontMetrics>
 #include <QInternal>
 #include <QPainter>
 #include <QPen>
-#include <QString>
+#include <QRegion>
 #include <QtGlobal>
 
 constexpr int lineNum = 4;
@@ -23,14 +30,20 @@ public:
                                                   int64_t desktoHeight,
                                                   int64_t stockNum) override;
   void paint(QPainter *painter, int64_t width, int64_t height,
-             const StockSet &stockSet, StockSetIt it) override;
+             const StockRegistry &stocks, size_t pos) override;
+  QRegion dirtyRegion(const StockRegistry &stocks,
+                      const std::vector<SymbolId> &changed, int64_t width,
+                      int64_t height, size_t pos) override;
 
   static bool regist;
 
 private:
   void drawSingleTextNumbers(QPainter *painter, const QColor &color,
-                             const Stock *stock, int startY, int width,
-                             int height);
+                             const Stock *stock, const Quote &quote,
+                             int startY, int width, int height);
+
+  TextCache texts;
+  int textWidth = 0; // Window width, measured on first use
 };
 
 std::pair<int64_t, int64_t>
@@ -42,32 +55,46 @@ DataOnlyMode::calculateWindowSize(int64_t desktopWidth, int64_t desktoHeight,
   int totalTextHeight = baseFontSize * (lineNum + 1) + lineSpacing * lineNum;
 
   // Calculate required text width (assuming the longest text is percentage
-  // with 1 decimal place)
-  QString sampleText = "+123.45%"; // Sample text for width calculation
-  QFont font("Arial Narrow", baseFontSize, QFont::Bold);
-  QFontMetrics fm(font);
-  int textWidth = fm.horizontalAdvance(sampleText) + 10;
+  // with 1 decimal place), it only depends on the font so measure once
+  if (textWidth == 0) {
+    QFontMetrics fm(texts.font(baseFontSize));
+    textWidth = fm.horizontalAdvance("+123.45%") + 10;
+  }
   return {textWidth, totalTextHeight};
 }
 
 void DataOnlyMode::paint(QPainter *painter, int64_t width, int64_t height,
-                         const StockSet &stockSet, StockSetIt it) {
+                         const StockRegistry &stocks, size_t pos) {
+  TRACE_SCOPE("DataOnlyMode::paint");
   QColor color;
   constexpr int alpha = 255 * 0.6;
   static const QColor redColor = QColor(255, 0, 0, alpha);
   static const QColor greenColor = QColor(0, 255, 0, alpha);
 
-  const Stock *stock = it->get();
+  const Stock *stock = &stocks.at(pos);
+  Quote quote = stocks.quotes().row(stocks.slotAt(pos));
   color = redColor;
-  if (stock->isBelow())
+  if (!quote.isPending() && quote.isBelow())
     color = greenColor;
 
-  drawSingleTextNumbers(painter, color, stock, 0, width, height);
+  drawSingleTextNumbers(painter, color, stock, quote, 0, width, height);
+}
+
+// Only one stock is shown, repaint if it is among changed.
+QRegion DataOnlyMode::dirtyRegion(const StockRegistry &stocks,
+                                  const std::vector<SymbolId> &changed,
+                                  int64_t width, int64_t height, size_t pos) {
+  if (pos >= stocks.size())
+    return QRegion();
+  SymbolId id = stocks.at(pos).getId();
+  if (std::find(changed.begin(), changed.end(), id) == changed.end())
+    return QRegion();
+  return QRegion(0, 0, width, height);
 }
 
 void DataOnlyMode::drawSingleTextNumbers(QPainter *painter, const QColor &color,
-                                         const Stock *stock, int startY,
-                                         int width, int height) {
+                                         const Stock *stock, const Quote &quote,
+                                         int startY, int width, int height) {
   // Determine font size
   int baseFontSize = qMin(height / 5, width / 6);
   baseFontSize = qMax(baseFontSize, 9);
@@ -78,46 +105,44 @@ void DataOnlyMode::drawSingleTextNumbers(QPainter *painter, const QColor &color,
   int lineSpacing =
       static_cast<int>(baseFontSize * 0.3); // Compact line spacing
 
-  // Set font
   painter->setPen(QPen(color));
   painter->setBrush(Qt::NoBrush);
-  painter->setFont(QFont("Arial Narrow", baseFontSize, QFont::Bold));
 
   int lineHeight = baseFontSize + lineSpacing;
-  const auto &name = stock->getName();
-  QString nameText(QString::fromUtf8(name.data(), name.size()));
-  if (nameText.length() >= 4)
-    nameText = nameText.left(2) + "...";
-  painter->drawText(0, startY, width, baseFontSize, Qt::AlignCenter, nameText);
+  char buf[32];
+  if (quote.isPending()) {
+    // Show the code and placeholders until the first fetch finishes
+    texts.drawCentered(painter, stock->getCode(), baseFontSize, 0, startY,
+                       width, baseFontSize);
+    for (int i = 0; i < 3; i++) {
+      startY += lineHeight;
+      texts.drawCentered(painter, "--", baseFontSize, 0, startY, width,
+                         baseFontSize);
+    }
+    return;
+  }
+  texts.drawCentered(painter, shortName(stock->getName(), buf, sizeof(buf)),
+                     baseFontSize, 0, startY, width, baseFontSize);
   startY += lineHeight;
 
   // First line: current value
-  int64_t n = 2;
-  auto curPrice = stock->getCurrentNumber();
-  if (curPrice < 10)
+  int n = 2;
+  if (quote.last < 10)
     n = 3;
-  QString currentText = QString("%1").arg(curPrice, 0, 'f', n);
-  painter->drawText(0, startY, width, baseFontSize, Qt::AlignCenter,
-                    currentText);
+  texts.drawCentered(painter, formatNumber(buf, sizeof(buf), quote.last, n),
+                     baseFontSize, 0, startY, width, baseFontSize);
   startY += lineHeight;
 
   // Second line: difference
-  auto diff = stock->getDifference();
-  QString diffText = QString("%1").arg(diff, 0, 'f', n);
-  if (diff >= 0) {
-    diffText = "+" + diffText;
-  }
-  painter->drawText(0, startY, width, baseFontSize, Qt::AlignCenter, diffText);
+  bool up = quote.diff >= 0;
+  texts.drawCentered(painter, formatNumber(buf, sizeof(buf), quote.diff, n, up),
+                     baseFontSize, 0, startY, width, baseFontSize);
   startY += lineHeight;
 
   // Third line: percentage
-  QString percentText =
-      QString("%1%").arg(stock->getPercentage(), 0, 'f', 2, '+');
-  if (diff >= 0) {
-    percentText = "+" + percentText;
-  }
-  painter->drawText(0, startY, width, baseFontSize, Qt::AlignCenter,
-                    percentText);
+  texts.drawCentered(painter,
+                     formatNumber(buf, sizeof(buf), quote.pct, 2, up, "%"),
+                     baseFontSize, 0, startY, width, baseFontSize);
 }
 
 bool DataOnlyMode::regist = DisplayMode::registCreator(
@@ -2,6 +2,8 @@
 
 #include "display_mode.h"
 
+#include <QRegion>
+
 static std::array<std::function<DisplayMode *()>,
                   static_cast<int>(DisplayMode::Type::kNum)>
     creators;
@@ -15,3 +17,9 @@ bool DisplayMode::registCreator(Type type,
 DisplayMode *DisplayMode::create(Type type) {
   return creators[static_cast<int>(type)]();
 }
+
+QRegion DisplayMode::dirtyRegion(const StockRegistry &stocks,
+                                 const std::vector<SymbolId> &changed,
+                                 int64_t width, int64_t height, size_t pos) {
+  return QRegion(0, 0, width, height);
+}
@@ -1,19 +1,25 @@
 #ifndef DISPLAY_STRATEGY_H
 #define DISPLAY_STRATEGY_H
 
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <utility>
+#include <vector>
 
-#include "stock.h"
+#include "stock_registry.h"
+#include "symbol_table.h"
 
 class QPainter;
+class QRegion;
 
 class DisplayMode {
 public:
   enum class Type : int {
     kLineChart = 0,
     kDataOnly = 1,
+    kTable = 2,
+    kHeatmap = 3,
     kNum,
   };
 
@@ -24,9 +30,22 @@ public:
                                                           int64_t desktoHeight,
                                                           int64_t stockNum) = 0;
 
-  // Paint window.
+  // Paint window, starting from display position pos of stocks. Only the
+  // clip region of painter needs to be painted.
   virtual void paint(QPainter *painter, int64_t width, int64_t height,
-                     const StockSet &stockSet, StockSetIt it) = 0;
+                     const StockRegistry &stocks, size_t pos) = 0;
+
+  // Region to repaint once the stocks in changed are updated, with the
+  // window showing from display position pos. The whole window by default.
+  virtual QRegion dirtyRegion(const StockRegistry &stocks,
+                              const std::vector<SymbolId> &changed,
+                              int64_t width, int64_t height, size_t pos);
+  // Scroll by rows on mouse wheel, return true if a repaint is needed.
+  virtual bool scroll(int64_t rows) { return false; }
+  // Left click at (x, y), return true if a repaint is needed.
+  virtual bool click(int64_t x, int64_t y, int64_t width, int64_t height) {
+    return false;
+  }
   static DisplayMode *create(Type type);
 
 protected:
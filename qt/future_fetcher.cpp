@@ -1,18 +1,25 @@
 #include <cassert>
-#include <cstdio>
+#include <cstdint>
+#include <exception>
+#include <limits>
 #include <map>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <string>
 #include <string_view>
 #include <tuple>
 #include <utility>
 
+#include "contract_calendar.h"
 #include "logger.h"
+#include "market_clock.h"
 #include "sina_fetcher.h"
 #include "stock_fetcher.h"
+#include "symbol_table.h"
 
-#include <QDateTime>
+#include <QDate>
+#include <QString>
 
 static const std::map<std::string_view, std::string> kNameMap{
     {"IH", "sh000922"},
@@ -21,31 +28,26 @@ static const std::map<std::string_view, std::string> kNameMap{
     {"IM", "sh000852"},
 };
 
-static std::pair<int, int> getNearestDate() {
-  const QDate date = QDate::currentDate();
-  int currentYear = date.year() % 100;
-  int currentMonth = date.month();
-
-  int remainder = currentMonth % 3;
-  if (remainder != 0) {
-    currentMonth = currentMonth + (3 - remainder);
-  }
-  return {currentYear, currentMonth};
-}
+using Slot = ContractCalendar::Slot;
 
 class SinaFutureFetcher : public SinaFetcher {
 public:
-  enum class Type : int {
-    kFront = 0,
-    kNext = 1,
-  };
-
-  SinaFutureFetcher(std::string_view name, Type fetchType);
+  SinaFutureFetcher(std::string_view product, Slot slot)
+      : SinaFutureFetcher(product, slot,
+                          ContractCalendar::instance().resolve(
+                              product, slot, MarketClock::instance().now())) {}
   ~SinaFutureFetcher() = default;
+  // Move to the contract now in the slot once the current one rolls, only
+  // a clock read until then.
   void updateContract();
-  const std::string &getContract() const { return futureCode; }
+  const std::string &getContract() const { return contract; }
 
 private:
+  SinaFutureFetcher(std::string_view product, Slot slot,
+                    const ContractCalendar::Contract &current)
+      : SinaFetcher(internSymbol(current.code), "nf_"), product(product),
+        slot(slot), contract(current.code), rollAt(current.rollAt) {}
+
   int getNameIdx() const override final { return -1; }
 
   int getCurPriceIdx() const override final { return 3; }
@@ -54,37 +56,49 @@ private:
 
   int getOpenPriceIdx() const override final { return 0; }
 
+  int getVolumeIdx() const override final { return 4; }
+
+  int getTurnoverIdx() const override final { return 5; }
+
 private:
-  Type type;
-  std::string futureCode;
+  std::string product;
+  Slot slot;
+  std::string contract;
+  int64_t rollAt; // ms since epoch
 };
 
-static std::tuple<std::string, SinaFutureFetcher::Type>
-parseCode(std::string_view code) {
+static std::tuple<std::string, Slot> parseCode(std::string_view code) {
   assert(code.size() > 3 && "Invalid future code");
   std::string_view name(code.data(), 2);
   std::string_view typeStr = code.substr(3);
   if (typeStr == "Front")
-    return std::tuple<std::string, SinaFutureFetcher::Type>{
-        name, SinaFutureFetcher::Type::kFront};
+    return {std::string(name), Slot::kQuarter};
   if (typeStr == "Next")
-    return std::tuple<std::string, SinaFutureFetcher::Type>{
-        name, SinaFutureFetcher::Type::kNext};
+    return {std::string(name), Slot::kNextQuarter};
+  if (typeStr == "Month")
+    return {std::string(name), Slot::kMonth};
+  if (typeStr == "NextMonth")
+    return {std::string(name), Slot::kNextMonth};
+  if (typeStr == "Quarter")
+    return {std::string(name), Slot::kFarQuarter};
+  if (typeStr == "NextQuarter")
+    return {std::string(name), Slot::kNextFarQuarter};
   LOG(FATAL) << "Invalid future code";
   __builtin_unreachable();
 }
 
 class SinaBackwardationFetcher : public StockFetcher {
 public:
-  SinaBackwardationFetcher(std::string stockCode) : StockFetcher(stockCode) {
-    auto [code, type] = parseCode(stockCode);
+  SinaBackwardationFetcher(SymbolId id) : StockFetcher(id) {
+    auto [code, slot] = parseCode(getCode());
     auto it = kNameMap.find(code);
     assert(it != kNameMap.end());
-    spot = std::unique_ptr<StockFetcher>(
-        StockFetcher::create(StockFetcher::Type::kSina, it->second));
-    future = std::make_unique<SinaFutureFetcher>(it->first, type);
+    spot = std::unique_ptr<StockFetcher>(StockFetcher::create(
+        StockFetcher::Type::kSina, internSymbol(it->second)));
+    future = std::make_unique<SinaFutureFetcher>(it->first, slot);
   }
   StockInfo fetchData() override final;
+  void fetchDataAsync(FetchCallback &&callback) override final;
   virtual ~SinaBackwardationFetcher() = default;
   static bool regist;
 
@@ -93,30 +107,23 @@ private:
   std::unique_ptr<SinaFutureFetcher> future;
 };
 
-static std::string getContractCode(std::string_view name,
-                                   SinaFutureFetcher::Type type) {
-  auto date = getNearestDate();
-  if (type == SinaFutureFetcher::Type::kNext) {
-    date.second += 3;
-  }
-  auto [year, month] = date;
-  if (month > 12) {
-    year += 1;
-    month = month % 12;
-  }
-  std::string ret(7, '\0');
-  snprintf(ret.data(), ret.size(), "%2s%02d%02d", name.data(), year, month);
-  ret.pop_back();
-  return ret;
-}
-
-SinaFutureFetcher::SinaFutureFetcher(std::string_view name, Type fetchType)
-    : SinaFetcher(getContractCode(name, fetchType)),
-      futureCode(getContractCode(name, fetchType)){};
-
 void SinaFutureFetcher::updateContract() {
-  auto newCode = getContractCode(getCode(), type);
-  setUrl(getUrl(newCode, "nf_"));
+  int64_t now = MarketClock::instance().now();
+  if (now < rollAt) [[likely]]
+    return;
+  try {
+    auto next = ContractCalendar::instance().resolve(product, slot, now);
+    LOG(INFO) << "Roll " << contract << " to " << next.code << ", expiring "
+              << next.expiry.toString(Qt::ISODate).toStdString();
+    contract = std::move(next.code);
+    rollAt = next.rollAt;
+    // Logs and metrics of the requests name the contract fetched
+    id = internSymbol(contract);
+    setUrl(getUrl(contract, "nf_"));
+  } catch (const std::exception &e) {
+    LOG(ERROR) << "Roll " << contract << " failed: " << e.what();
+    rollAt = std::numeric_limits<int64_t>::max();
+  }
 }
 
 StockInfo SinaBackwardationFetcher::fetchData() {
@@ -126,12 +133,52 @@ StockInfo SinaBackwardationFetcher::fetchData() {
   return StockInfo{.name = future->getContract(),
                    .curPrice = futurePrice.curPrice,
                    .yesterdayPrice = spotPrice.curPrice,
-                   .openPrice = spotPrice.curPrice};
+                   .openPrice = spotPrice.curPrice,
+                   .volume = futurePrice.volume,
+                   .turnover = futurePrice.turnover};
+}
+
+void SinaBackwardationFetcher::fetchDataAsync(FetchCallback &&callback) {
+  // Spot and future are requested in parallel, the last reply to arrive
+  // builds the result.
+  struct Join {
+    std::optional<StockInfo> spot;
+    std::optional<StockInfo> future;
+    int pending = 2;
+    std::string contract;
+    FetchCallback callback;
+  };
+  future->updateContract();
+  auto join = std::make_shared<Join>();
+  join->contract = future->getContract();
+  join->callback = std::move(callback);
+  auto finish = [join]() {
+    if (--join->pending > 0)
+      return;
+    if (!join->spot || !join->future) {
+      join->callback(std::nullopt);
+      return;
+    }
+    join->callback(StockInfo{.name = join->contract,
+                             .curPrice = join->future->curPrice,
+                             .yesterdayPrice = join->spot->curPrice,
+                             .openPrice = join->spot->curPrice,
+                             .volume = join->future->volume,
+                             .turnover = join->future->turnover});
+  };
+  spot->fetchDataAsync([join, finish](std::optional<StockInfo> info) {
+    join->spot = std::move(info);
+    finish();
+  });
+  future->fetchDataAsync([join, finish](std::optional<StockInfo> info) {
+    join->future = std::move(info);
+    finish();
+  });
 }
 
 // Register factory method for SinaBackwardationFetcher
 bool SinaBackwardationFetcher::regist = SinaBackwardationFetcher::registCreator(
     StockFetcher::Type::kSinaBackwardation,
-    [](std::string stockCode) -> StockFetcher * {
-      return new SinaBackwardationFetcher(stockCode);
+    [](SymbolId id) -> StockFetcher * {
+      return new SinaBackwardationFetcher(id);
     });
@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "display_mode.h"
+#include "quote_table.h"
+#include "stock.h"
+#include "stock_registry.h"
+#include "symbol_table.h"
+#include "text_cache.h"
+#include "trace.h"
+
+#include <QColor>
+#include <QImage>
+#include <QInternal>
+#include <QPainter>
+#include <QPen>
+#include <QRect>
+#include <QRectF>
+#include <QRegion>
+#include <QSize>
+#include <QString>
+#include <QtGlobal>
+
+// Every stock of the watchlist as a tile of a squarified treemap, coloured by
+// percent change and optionally sized by turnover. The layout is computed
+// only when the membership, the window size or the weights change much, and
+// tiles are painted into a backing image at device resolution, so a tick
+// only recolours the tiles of the changed stocks and a paint is a blit.
+class HeatmapMode final : public DisplayMode {
+public:
+  std::pair<int64_t, int64_t> calculateWindowSize(int64_t desktopWidth,
+                                                  int64_t desktoHeight,
+                                                  int64_t stockNum) override;
+  void paint(QPainter *painter, int64_t width, int64_t height,
+             const StockRegistry &stocks, size_t pos) override;
+  QRegion dirtyRegion(const StockRegistry &stocks,
+                      const std::vector<SymbolId> &changed, int64_t width,
+                      int64_t height, size_t pos) override;
+  bool click(int64_t x, int64_t y, int64_t width, int64_t height) override;
+
+  static bool regist;
+
+private:
+  struct Tile {
+    SymbolId id;
+    QRect rect;
+    int64_t drawnUpdate; // Quote time the tile was drawn with
+  };
+  // Relayout once a weight share drifts by this fraction of itself
+  static constexpr double maxDrift = 0.2;
+
+  bool byTurnover = false;
+  uint64_t generation = UINT64_MAX;
+  std::vector<Tile> tiles;
+  std::vector<double> shares;   // Weight share of each tile at layout time
+  QImage canvas;
+  QSize canvasSize;             // In logical pixels
+  qreal ratio = 1.0;            // Device pixel ratio of the last paint
+  uint64_t colouredVersion = 0; // QuoteTable version of the tile colours
+  TextCache fonts;
+
+  bool needLayout(const StockRegistry &stocks, int64_t width, int64_t height);
+  std::vector<double> weights(const StockRegistry &stocks,
+                              const std::vector<SymbolId> &ids) const;
+  void layout(const StockRegistry &stocks, int64_t width, int64_t height);
+  void drawTile(QPainter *painter, const StockRegistry &stocks, Tile &tile);
+  QRegion recolour(const StockRegistry &stocks);
+};
+
+std::pair<int64_t, int64_t>
+HeatmapMode::calculateWindowSize(int64_t desktopWidth, int64_t desktoHeight,
+                                 int64_t stockNum) {
+  // Grow with the watchlist, up to a quarter of the screen
+  int64_t width = desktopWidth / 6;
+  if (stockNum > 50)
+    width = desktopWidth / 4;
+  width = qMax(width, int64_t(300));
+  return {width, qMin(width * 3 / 4, desktoHeight / 2)};
+}
+
+// Weights of ids, equal unless sized by turnover. Pending and untraded stocks
+// get a tenth of the mean weight, so they stay visible.
+std::vector<double>
+HeatmapMode::weights(const StockRegistry &stocks,
+                     const std::vector<SymbolId> &ids) const {
+  std::vector<double> result(ids.size(), 1.0);
+  if (!byTurnover)
+    return result;
+  const auto &turnover = stocks.quotes().getTurnover();
+  double sum = 0.0;
+  size_t count = 0;
+  for (size_t i = 0; i < ids.size(); i++) {
+    result[i] = turnover[stocks.getSlot(ids[i])];
+    if (result[i] > 0) {
+      sum += result[i];
+      count++;
+    }
+  }
+  double minWeight = count ? sum / count * 0.1 : 1.0;
+  for (auto &weight : result)
+    weight = std::max(weight, minWeight);
+  return result;
+}
+
+bool HeatmapMode::needLayout(const StockRegistry &stocks, int64_t width,
+                             int64_t height) {
+  if (generation != stocks.getGeneration() ||
+      canvasSize != QSize(width, height) || canvas.devicePixelRatio() != ratio)
+    return true;
+  if (!byTurnover)
+    return false;
+  std::vector<SymbolId> ids;
+  ids.reserve(tiles.size());
+  for (const auto &tile : tiles)
+    ids.push_back(tile.id);
+  auto current = weights(stocks, ids);
+  double sum = 0.0;
+  for (double weight : current)
+    sum += weight;
+  for (size_t i = 0; i < current.size(); i++) {
+    if (std::abs(current[i] / sum - shares[i]) > shares[i] * maxDrift)
+      return true;
+  }
+  return false;
+}
+
+// Squarified treemap (Bruls, Huizing, van Wijk): largest weights first, each
+// strip along the shorter side takes items while its worst aspect ratio
+// improves.
+void HeatmapMode::layout(const StockRegistry &stocks, int64_t width,
+                         int64_t height) {
+  generation = stocks.getGeneration();
+  std::vector<SymbolId> ids;
+  ids.reserve(stocks.size());
+  for (size_t pos = 0; pos < stocks.size(); pos++)
+    ids.push_back(stocks.at(pos).getId());
+  auto weight = weights(stocks, ids);
+
+  std::vector<size_t> order(ids.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  // Stable, so equal weights keep the code order
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return weight[a] > weight[b]; });
+  double sum = 0.0;
+  for (double w : weight)
+    sum += w;
+
+  tiles.clear();
+  shares.clear();
+  tiles.reserve(ids.size());
+  shares.reserve(ids.size());
+
+  const double scale = sum > 0 ? width * height / sum : 0.0;
+  double x = 0, y = 0, w = width, h = height;
+  size_t i = 0;
+  while (i < order.size()) {
+    double side = std::min(w, h);
+    double rowSum = 0.0;
+    double worst = std::numeric_limits<double>::infinity();
+    size_t j = i;
+    for (; j < order.size(); j++) {
+      double area = weight[order[j]] * scale;
+      double s = rowSum + area;
+      // Items are sorted, so the first is the largest and j the smallest
+      double largest = weight[order[i]] * scale;
+      double ratio = std::max(side * side * largest / (s * s),
+                              s * s / (side * side * area));
+      if (ratio > worst)
+        break;
+      worst = ratio;
+      rowSum = s;
+    }
+    // Lay the strip [i, j) along the shorter side
+    double thick = side > 0 ? rowSum / side : 0.0;
+    double offset = 0.0;
+    for (size_t k = i; k < j; k++) {
+      double length = thick > 0 ? weight[order[k]] * scale / thick : 0.0;
+      // A column on the left of a wide area, a row on top of a tall one
+      bool column = w >= h;
+      double x0 = column ? x : x + offset;
+      double y0 = column ? y + offset : y;
+      double x1 = column ? x + thick : x0 + length;
+      double y1 = column ? y0 + length : y + thick;
+      offset += length;
+      // Round edges rather than sizes, so neighbours share them exactly
+      int left = std::lround(x0), top = std::lround(y0);
+      tiles.push_back(Tile{ids[order[k]],
+                           QRect(left, top, std::lround(x1) - left,
+                                 std::lround(y1) - top),
+                           0});
+      shares.push_back(sum > 0 ? weight[order[k]] / sum : 0.0);
+    }
+    if (w >= h) {
+      x += thick;
+      w -= thick;
+    } else {
+      y += thick;
+      h -= thick;
+    }
+    i = j;
+  }
+
+  canvasSize = QSize(width, height);
+  canvas = QImage(canvasSize * ratio, QImage::Format_ARGB32_Premultiplied);
+  canvas.setDevicePixelRatio(ratio);
+  canvas.fill(Qt::transparent);
+  colouredVersion = stocks.quotes().getVersion();
+  QPainter painter(&canvas);
+  for (auto &tile : tiles)
+    drawTile(&painter, stocks, tile);
+}
+
+// Redraw the tiles whose quote changed since the canvas was coloured, also
+// those of ticks while another mode was shown. Return their region.
+QRegion HeatmapMode::recolour(const StockRegistry &stocks) {
+  QRegion region;
+  if (colouredVersion == stocks.quotes().getVersion())
+    return region;
+  colouredVersion = stocks.quotes().getVersion();
+  const auto &lastUpdate = stocks.quotes().getLastUpdate();
+  QPainter painter(&canvas);
+  for (auto &tile : tiles) {
+    if (lastUpdate[stocks.getSlot(tile.id)] == tile.drawnUpdate)
+      continue;
+    drawTile(&painter, stocks, tile);
+    region += tile.rect;
+  }
+  return region;
+}
+
+void HeatmapMode::drawTile(QPainter *painter, const StockRegistry &stocks,
+                           Tile &tile) {
+  // Deeper colour for bigger moves, saturated at 5%
+  constexpr double saturatePct = 5.0;
+  static const QColor pendingColor = QColor(128, 128, 128, 100);
+  static const QColor textColor = QColor(255, 255, 255, 220);
+
+  Quote quote = stocks.quotes().row(stocks.getSlot(tile.id));
+  tile.drawnUpdate = quote.lastUpdate;
+  QColor color = pendingColor;
+  if (!quote.isPending()) {
+    double t = std::min(std::abs(quote.pct) / saturatePct, 1.0);
+    int alpha = 255 * (0.25 + 0.5 * t);
+    color = quote.isBelow() ? QColor(0, 255, 0, alpha)
+                            : QColor(255, 0, 0, alpha);
+  }
+  // Source mode replaces the old colour instead of blending over it, leave a
+  // one pixel gap between tiles
+  painter->setCompositionMode(QPainter::CompositionMode_Source);
+  painter->fillRect(tile.rect, Qt::transparent);
+  QRect inner(tile.rect.x(), tile.rect.y(), tile.rect.width() - 1,
+              tile.rect.height() - 1);
+  painter->fillRect(inner, color);
+  painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+  int fontSize = qMin(inner.height() / 3, inner.width() / 5);
+  if (fontSize < 8)
+    return;
+  painter->setFont(fonts.pixelFont(fontSize));
+  painter->setPen(QPen(textColor));
+  QString text = QString::fromStdString(symbolCode(tile.id));
+  if (!quote.isPending()) {
+    const auto name = stocks.find(tile.id)->getName();
+    if (!name.empty())
+      text = QString::fromUtf8(name.data(), name.size());
+    QString pct = QString::number(quote.pct, 'f', 2) + "%";
+    if (quote.pct >= 0)
+      pct = "+" + pct;
+    text += "\n" + pct;
+  }
+  painter->drawText(inner, Qt::AlignCenter, text);
+}
+
+void HeatmapMode::paint(QPainter *painter, int64_t width, int64_t height,
+                        const StockRegistry &stocks, size_t pos) {
+  TRACE_SCOPE("HeatmapMode::paint");
+  ratio = painter->device()->devicePixelRatioF();
+  if (needLayout(stocks, width, height))
+    layout(stocks, width, height);
+  else
+    recolour(stocks);
+  QRect clip(0, 0, width, height);
+  if (painter->hasClipping())
+    clip = painter->clipBoundingRect().toAlignedRect();
+  // The canvas is in device pixels
+  painter->drawImage(QRectF(clip), canvas,
+                     QRectF(clip.x() * ratio, clip.y() * ratio,
+                            clip.width() * ratio, clip.height() * ratio));
+}
+
+QRegion HeatmapMode::dirtyRegion(const StockRegistry &stocks,
+                                 const std::vector<SymbolId> &changed,
+                                 int64_t width, int64_t height, size_t pos) {
+  if (needLayout(stocks, width, height)) {
+    layout(stocks, width, height);
+    return QRegion(0, 0, width, height);
+  }
+  // Compared by quote time rather than taken from changed, which misses the
+  // ticks painted by another mode
+  return recolour(stocks);
+}
+
+// Clicking toggles between equal tiles and tiles sized by turnover.
+bool HeatmapMode::click(int64_t x, int64_t y, int64_t width, int64_t height) {
+  byTurnover = !byTurnover;
+  generation = UINT64_MAX;
+  return true;
+}
+
+bool HeatmapMode::regist = DisplayMode::registCreator(
+    DisplayMode::Type::kHeatmap,
+    []() -> DisplayMode * { return new HeatmapMode; });
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <utility>
+
+#include "indicator.h"
+#include "logger.h"
+#include "utils.h"
+
+static std::array<std::function<Indicator *(const IndicatorSpec &)>,
+                  static_cast<int>(IndicatorSpec::Type::kNum)>
+    creators;
+
+static constexpr std::array<std::string_view,
+                            static_cast<int>(IndicatorSpec::Type::kNum)>
+    kNames = {"ma", "ema", "vwap", "boll", "rsi"};
+
+static bool parseNumber(std::string_view sv, double &out) {
+  auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), out);
+  return ec == std::errc() && ptr == sv.data() + sv.size();
+}
+
+std::optional<IndicatorSpec> parseIndicator(std::string_view text) {
+  auto fields = splitString(text, ':');
+  if (fields.empty())
+    return std::nullopt;
+  auto it = std::find(kNames.begin(), kNames.end(), fields[0]);
+  if (it == kNames.end())
+    return std::nullopt;
+
+  IndicatorSpec spec{.type = static_cast<IndicatorSpec::Type>(
+                         std::distance(kNames.begin(), it)),
+                     .period = 0,
+                     .width = 0.0};
+  // Expected number of numeric arguments
+  size_t argNum = 1;
+  if (spec.type == IndicatorSpec::Type::kVWAP)
+    argNum = 0;
+  else if (spec.type == IndicatorSpec::Type::kBoll)
+    argNum = 2;
+  if (fields.size() != argNum + 1)
+    return std::nullopt;
+
+  double value;
+  if (argNum >= 1) {
+    if (!parseNumber(fields[1], value) || value < 1 || value > 10000 ||
+        value != std::floor(value))
+      return std::nullopt;
+    spec.period = static_cast<int>(value);
+  }
+  if (argNum >= 2) {
+    if (!parseNumber(fields[2], value) || value <= 0)
+      return std::nullopt;
+    spec.width = value;
+  }
+  return spec;
+}
+
+std::string toString(const IndicatorSpec &spec) {
+  std::string ret(kNames[static_cast<int>(spec.type)]);
+  if (spec.type != IndicatorSpec::Type::kVWAP)
+    ret.append(":").append(std::to_string(spec.period));
+  if (spec.type == IndicatorSpec::Type::kBoll) {
+    char buf[32];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), spec.width);
+    ret.append(":").append(buf, ptr);
+  }
+  return ret;
+}
+
+Indicator::Indicator(const IndicatorSpec &spec, int seriesNum,
+                     bool priceScale)
+    : output{.spec = spec,
+             .seriesNum = seriesNum,
+             .priceScale = priceScale,
+             .series = {}} {}
+
+void Indicator::push(double price, double volume) {
+  double values[IndicatorOutput::kMaxSeries];
+  step(price, volume, values);
+  for (int i = 0; i < output.seriesNum; i++) {
+    auto &series = output.series[i];
+    // The first tick fills the whole chart, as the price history does
+    if (series.empty())
+      series.push_back(series.capacity(), values[i]);
+    else
+      series.push_back(values[i]);
+  }
+}
+
+bool Indicator::registCreator(
+    IndicatorSpec::Type type,
+    std::function<Indicator *(const IndicatorSpec &)> &&fn) {
+  creators[static_cast<int>(type)] = std::move(fn);
+  return true;
+}
+
+Indicator *Indicator::create(const IndicatorSpec &spec) {
+  const auto &fn = creators[static_cast<int>(spec.type)];
+  if (!fn)
+    LOG(FATAL) << "Invalid indicator type";
+  return fn(spec);
+}
+
+void SlidingWindow::push(double v) {
+  if (count == values.size()) {
+    sum -= values[pos];
+    sumSq -= values[pos] * values[pos];
+  } else {
+    count++;
+  }
+  values[pos] = v;
+  sum += v;
+  sumSq += v * v;
+  pos = (pos + 1) % values.size();
+}
+
+double SlidingWindow::variance() const {
+  double m = mean();
+  // Running sums may drift slightly below zero
+  return std::max(0.0, sumSq / count - m * m);
+}
+
+class MovingAverage final : public Indicator {
+public:
+  explicit MovingAverage(const IndicatorSpec &spec)
+      : Indicator(spec, 1, true), window(spec.period) {}
+  static bool regist;
+
+private:
+  void step(double price, double volume, double *values) override {
+    window.push(price);
+    values[0] = window.mean();
+  }
+  SlidingWindow window;
+};
+
+bool MovingAverage::regist = Indicator::registCreator(
+    IndicatorSpec::Type::kMA, [](const IndicatorSpec &spec) -> Indicator * {
+      return new MovingAverage(spec);
+    });
+
+class ExponentialMovingAverage final : public Indicator {
+public:
+  explicit ExponentialMovingAverage(const IndicatorSpec &spec)
+      : Indicator(spec, 1, true), alpha(2.0 / (spec.period + 1)) {}
+  static bool regist;
+
+private:
+  void step(double price, double volume, double *values) override {
+    ema = first ? price : ema + alpha * (price - ema);
+    first = false;
+    values[0] = ema;
+  }
+  double alpha;
+  double ema = 0.0;
+  bool first = true;
+};
+
+bool ExponentialMovingAverage::regist = Indicator::registCreator(
+    IndicatorSpec::Type::kEMA, [](const IndicatorSpec &spec) -> Indicator * {
+      return new ExponentialMovingAverage(spec);
+    });
+
+class VolumeWeightedAveragePrice final : public Indicator {
+public:
+  explicit VolumeWeightedAveragePrice(const IndicatorSpec &spec)
+      : Indicator(spec, 1, true) {}
+  static bool regist;
+
+private:
+  void step(double price, double volume, double *values) override {
+    // Volume is accumulated by the provider, weight a tick by its delta.
+    // Volume before the first tick is unknown, and providers without
+    // volume report 0, so those ticks weigh 1.
+    double weight = 1.0;
+    if (!first && volume > 0.0) {
+      if (volume < lastVolume) {
+        // New session, its volume so far is all behind this tick
+        priceVolume = 0.0;
+        totalVolume = 0.0;
+        weight = volume;
+      } else {
+        weight = volume - lastVolume;
+      }
+    }
+    first = false;
+    lastVolume = volume;
+    priceVolume += price * weight;
+    totalVolume += weight;
+    values[0] = totalVolume > 0.0 ? priceVolume / totalVolume : price;
+  }
+  double priceVolume = 0.0;
+  double totalVolume = 0.0;
+  double lastVolume = 0.0;
+  bool first = true;
+};
+
+bool VolumeWeightedAveragePrice::regist = Indicator::registCreator(
+    IndicatorSpec::Type::kVWAP, [](const IndicatorSpec &spec) -> Indicator * {
+      return new VolumeWeightedAveragePrice(spec);
+    });
+
+class BollingerBands final : public Indicator {
+public:
+  explicit BollingerBands(const IndicatorSpec &spec)
+      : Indicator(spec, 3, true), window(spec.period), width(spec.width) {}
+  static bool regist;
+
+private:
+  void step(double price, double volume, double *values) override {
+    window.push(price);
+    double mid = window.mean();
+    double band = width * std::sqrt(window.variance());
+    values[0] = mid;
+    values[1] = mid + band;
+    values[2] = mid - band;
+  }
+  SlidingWindow window;
+  double width;
+};
+
+bool BollingerBands::regist = Indicator::registCreator(
+    IndicatorSpec::Type::kBoll, [](const IndicatorSpec &spec) -> Indicator * {
+      return new BollingerBands(spec);
+    });
+
+class RelativeStrengthIndex final : public Indicator {
+public:
+  explicit RelativeStrengthIndex(const IndicatorSpec &spec)
+      : Indicator(spec, 1, false), period(spec.period) {}
+  static bool regist;
+
+private:
+  void step(double price, double volume, double *values) override {
+    if (!hasLast) {
+      hasLast = true;
+      lastPrice = price;
+      values[0] = 50.0;
+      return;
+    }
+    double change = price - lastPrice;
+    lastPrice = price;
+    double gain = std::max(change, 0.0);
+    double loss = std::max(-change, 0.0);
+    if (changes < period) {
+      // Simple average until the first period is complete
+      changes++;
+      avgGain += (gain - avgGain) / changes;
+      avgLoss += (loss - avgLoss) / changes;
+    } else {
+      // Wilder's smoothing
+      avgGain = (avgGain * (period - 1) + gain) / period;
+      avgLoss = (avgLoss * (period - 1) + loss) / period;
+    }
+    if (avgGain == 0.0 && avgLoss == 0.0)
+      values[0] = 50.0;
+    else if (avgLoss == 0.0)
+      values[0] = 100.0;
+    else
+      values[0] = 100.0 - 100.0 / (1.0 + avgGain / avgLoss);
+  }
+  int period;
+  int changes = 0;
+  bool hasLast = false;
+  double lastPrice = 0.0;
+  double avgGain = 0.0;
+  double avgLoss = 0.0;
+};
+
+bool RelativeStrengthIndex::regist = Indicator::registCreator(
+    IndicatorSpec::Type::kRSI, [](const IndicatorSpec &spec) -> Indicator * {
+      return new RelativeStrengthIndex(spec);
+    });
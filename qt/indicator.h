@@ -0,0 +1,86 @@
+#ifndef INDICATOR_H
+#define INDICATOR_H
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ring_buffer.h"
+
+using Series = ring_buffer<double, 240>;
+
+struct IndicatorSpec {
+  enum class Type : int {
+    kMA = 0,   // Simple moving average
+    kEMA = 1,  // Exponential moving average
+    kVWAP = 2, // Volume weighted average price of the session
+    kBoll = 3, // Bollinger bands: middle, upper, lower
+    kRSI = 4,  // Relative strength index, 0-100
+    kNum,
+  };
+  Type type;
+  int period;   // In ticks, unused by VWAP
+  double width; // Band width in standard deviations, Boll only
+  bool operator==(const IndicatorSpec &other) const = default;
+};
+
+// Parse "ma:20", "ema:12", "vwap", "boll:20:2" or "rsi:14" as written in the
+// config file, return std::nullopt if invalid.
+std::optional<IndicatorSpec> parseIndicator(std::string_view text);
+std::string toString(const IndicatorSpec &spec);
+
+// Output series of an indicator, aligned with the price history.
+struct IndicatorOutput {
+  static constexpr int kMaxSeries = 3;
+  IndicatorSpec spec;
+  int seriesNum;
+  bool priceScale; // Drawn on the price axis, otherwise on 0-100
+  std::array<Series, kMaxSeries> series;
+};
+
+// Streaming state machine of one indicator, each tick is consumed in O(1).
+class Indicator {
+public:
+  virtual ~Indicator() = default;
+
+  // Consume one tick, volume is the accumulated volume of the day.
+  void push(double price, double volume);
+  const IndicatorOutput &getOutput() const { return output; }
+
+  static Indicator *create(const IndicatorSpec &spec);
+
+protected:
+  Indicator(const IndicatorSpec &spec, int seriesNum, bool priceScale);
+  // Write the value of each series for this tick.
+  virtual void step(double price, double volume, double *values) = 0;
+
+  static bool
+  registCreator(IndicatorSpec::Type type,
+                std::function<Indicator *(const IndicatorSpec &)> &&fn);
+
+private:
+  IndicatorOutput output;
+};
+
+// Last period values with a running sum and sum of squares.
+class SlidingWindow {
+public:
+  explicit SlidingWindow(int period) : values(period, 0.0) {}
+  void push(double v);
+  size_t size() const { return count; }
+  double mean() const { return sum / count; }
+  double variance() const;
+
+private:
+  std::vector<double> values;
+  size_t pos = 0;
+  size_t count = 0;
+  double sum = 0.0;
+  double sumSq = 0.0;
+};
+
+#endif // INDICATOR_H
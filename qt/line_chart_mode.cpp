@@ -1,49 +1,148 @@
 #include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <map>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "display_mode.h"
+#include "indicator.h"
+#include "logger.h"
+#include "quote_table.h"
 #include "ring_buffer.h"
+#include "sparkline.h"
 #include "stock.h"
+#include "stock_registry.h"
+#include "symbol_table.h"
+#include "text_cache.h"
+#include "trace.h"
+#include "utils.h"
 
 #include <QBrush>
 #include <QColor>
-#include <QFont>
+#include <QImage>
 #include <QInternal>
+#include <QPaintDevice>
 #include <QPainter>
-#include <QPainterPath>
 #include <QPen>
-#include <QString>
+#include <QPointF>
+#include <QPolygonF>
+#include <QRect>
+#include <QRegion>
+#include <QRgb>
+#include <QSize>
 #include <QtGlobal>
 
 static const QColor transparentColor = QColor(255, 0, 0, 0);
+// Overlay colors, indexed by IndicatorSpec::Type
+static const std::array<QColor, static_cast<int>(IndicatorSpec::Type::kNum)>
+    indicatorColors = {
+        QColor(255, 215, 0, 200),   // MA
+        QColor(0, 191, 255, 200),   // EMA
+        QColor(255, 0, 255, 200),   // VWAP
+        QColor(200, 200, 200, 160), // Boll
+        QColor(255, 140, 0, 200),   // RSI
+};
 constexpr int pad = 10;
 class LineChartMode final : public DisplayMode {
 public:
+  LineChartMode();
   std::pair<int64_t, int64_t> calculateWindowSize(int64_t desktopWidth,
                                                   int64_t desktoHeight,
                                                   int64_t stockNum) override;
   void paint(QPainter *painter, int64_t width, int64_t height,
-             const StockSet &stockSet, StockSetIt it) override;
+             const StockRegistry &stocks, size_t pos) override;
+  QRegion dirtyRegion(const StockRegistry &stocks,
+                      const std::vector<SymbolId> &changed, int64_t width,
+                      int64_t height, size_t pos) override;
 
   static bool regist;
 
 private:
-  void drawSingleLineChart(QPainter *painter, const QColor &color,
-                           const Stock *stock, int startX, int startY,
-                           int width, int height);
+  // Price line of a stock in chart coordinates, extended by the new ticks of
+  // each publish and rescaled only when the price range changes. Point i is
+  // at x = i * xStep, the shown history is [start, size).
+  struct ChartPath {
+    QPolygonF points;
+    size_t start = 0;
+    uint64_t version = 0; // Stock version the points are built from
+    double ub = 0.0;      // Price at y = 0
+    double diff = 0.0;    // Price range over the height
+    double xStep = 0.0;
+    int height = 0;
+  };
+
+  // Rendered chart and text of a stock, reused until any part of its key
+  // changes, so an idle repaint is a blit per stock.
+  struct Layer {
+    SymbolId id = kInvalidSymbol;
+    uint64_t version;    // Stock::getVersion(), bumped by new history
+    int64_t lastUpdate;  // Quote fields the text is built from
+    double diff;
+    QSize size;
+    QRgb color;
+    uint64_t lastUse = 0;
+    QImage image;
+    ChartPath path;
+  };
+  // Enough for the shown stocks and the ones rolled in next
+  static constexpr size_t maxLayers = 10;
+  std::array<Layer, maxLayers> layers;
+  uint64_t useClock = 0;
+  QPolygonF overlay; // Reused by indicator overlays
+  TextCache texts;
+
+  // Draw price lines with the software rasteriser instead of QPainter, set
+  // by MONITOR_RENDERER=soft, or =check to also compare each chart with
+  // QPainter's and warn when they differ beyond the known differences
+  bool softRender = false;
+  bool checkRender = false;
+  static constexpr int checkTolerance = 48; // Channel levels
+
+  const QImage &getLayer(QPainter *painter, const QColor &color,
+                          const Stock *stock, const Quote &quote, int width,
+                          int height, int numberAreaWidth);
+  static void updatePath(ChartPath &path, const Data &numbers,
+                         uint64_t version, double ub, double diff, int width,
+                         int height);
+  void drawSingleLineChart(QPainter *painter, QImage &image,
+                           const QColor &color, const Stock *stock,
+                           const Quote &quote, ChartPath &path, int startX,
+                           int startY, int width, int height);
+  void drawPolygonChart(QPainter *painter, const QColor &color,
+                        ChartPath &path, const Data &numbers, uint64_t version,
+                        double ub, double diff, int startX, int startY,
+                        int width, int height);
+  void drawOverlays(QPainter *painter,
+                    const std::vector<IndicatorOutput> &indicators, double ub,
+                    double diff, int startX, int startY, int width,
+                    int height);
   void drawSingleTextNumbers(QPainter *painter, const QColor &color,
-                             const Stock *stock, int startY, int width,
-                             int height);
+                             const Stock *stock, const Quote &quote,
+                             int startY, int width, int height);
   static inline int64_t calDisplayNum(int64_t totalNum) {
     return std::min(totalNum, int64_t(5));
   }
 };
 
+LineChartMode::LineChartMode() {
+  try {
+    auto renderer = getenv<std::string_view>("MONITOR_RENDERER");
+    checkRender = renderer == "check";
+    softRender = renderer == "soft" || checkRender;
+  } catch (const std::unset_env &e) {
+  }
+  if (checkRender)
+    LOG(INFO) << "Line charts use the software renderer, checked against "
+                 "QPainter";
+  else if (softRender)
+    LOG(INFO) << "Line charts use the software renderer";
+}
+
 std::pair<int64_t, int64_t>
 LineChartMode::calculateWindowSize(int64_t desktopWidth, int64_t desktoHeight,
                                    int64_t stockNum) {
@@ -72,47 +171,171 @@ LineChartMode::calculateWindowSize(int64_t desktopWidth, int64_t desktoHeight,
 }
 
 void LineChartMode::paint(QPainter *painter, int64_t width, int64_t height,
-                          const StockSet &stockSet, StockSetIt it) {
+                          const StockRegistry &stocks, size_t pos) {
+  TRACE_SCOPE("LineChartMode::paint");
   constexpr int alpha = 255 * 0.6;
   static const QColor redColor = QColor(255, 0, 0, alpha);
   static const QColor greenColor = QColor(0, 255, 0, alpha);
 
-  int64_t displayNum = calDisplayNum(stockSet.size());
+  int64_t displayNum = calDisplayNum(stocks.size());
   // Layout settings: text on left (20% width), line chart on right (80%
   // width)
   int64_t numberAreaWidth = width / 5;
-  int64_t graphWidth = width - numberAreaWidth;
   int64_t graphHeight = height / displayNum;
-  int64_t graphStartX = numberAreaWidth;
   int64_t graphStartY = 0;
 
   for (int i = 0; i < displayNum; i++) {
-    const Stock *stock = it->get();
+    const Stock *stock = &stocks.at(pos);
+    Quote quote = stocks.quotes().row(stocks.slotAt(pos));
     QColor color = redColor;
-    if (stock->isBelow())
+    if (!quote.isPending() && quote.isBelow())
       color = greenColor;
-    // Draw line chart
-    drawSingleLineChart(painter, color, stock, graphStartX, graphStartY,
-                        graphWidth, graphHeight - pad);
-    // Draw text
-    drawSingleTextNumbers(painter, color, stock, graphStartY, numberAreaWidth,
-                          graphHeight - pad);
+    painter->drawImage(0, graphStartY,
+                        getLayer(painter, color, stock, quote, width,
+                                 graphHeight, numberAreaWidth));
     graphStartY += graphHeight;
-    ++it;
-    if (it == stockSet.cend())
-      it = stockSet.cbegin();
+    if (++pos == stocks.size())
+      pos = 0;
+  }
+}
+
+// Rows of the shown stocks in changed, each one a graphHeight slot as laid
+// out by paint.
+QRegion LineChartMode::dirtyRegion(const StockRegistry &stocks,
+                                   const std::vector<SymbolId> &changed,
+                                   int64_t width, int64_t height, size_t pos) {
+  QRegion region;
+  int64_t displayNum = calDisplayNum(stocks.size());
+  if (displayNum == 0 || changed.empty())
+    return region;
+  int64_t graphHeight = height / displayNum;
+  for (int64_t i = 0; i < displayNum; i++) {
+    SymbolId id = stocks.at(pos).getId();
+    if (std::find(changed.begin(), changed.end(), id) != changed.end())
+      region += QRect(0, i * graphHeight, width, graphHeight);
+    if (++pos == stocks.size())
+      pos = 0;
+  }
+  return region;
+}
+
+// Return the cached layer of stock, render it again if stale. Text may spill
+// into the pad below the chart, so the layer covers the whole row.
+const QImage &LineChartMode::getLayer(QPainter *painter, const QColor &color,
+                                      const Stock *stock, const Quote &quote,
+                                      int width, int height,
+                                      int numberAreaWidth) {
+  QSize size(width, height);
+  uint64_t version = stock->getVersion();
+  Layer *layer = nullptr;
+  for (auto &candidate : layers) {
+    if (candidate.id == stock->getId()) {
+      layer = &candidate;
+      break;
+    }
+    // Otherwise reuse the least recently used one
+    if (!layer || candidate.lastUse < layer->lastUse)
+      layer = &candidate;
+  }
+  layer->lastUse = ++useClock;
+  if (layer->id == stock->getId() && layer->version == version &&
+      layer->lastUpdate == quote.lastUpdate && layer->diff == quote.diff &&
+      layer->size == size && layer->color == color.rgba())
+    return layer->image;
+
+  // The path of the same stock is extended, not rebuilt
+  if (layer->id != stock->getId())
+    layer->path = ChartPath();
+  layer->id = stock->getId();
+  layer->version = version;
+  layer->lastUpdate = quote.lastUpdate;
+  layer->diff = quote.diff;
+  layer->size = size;
+  layer->color = color.rgba();
+  // Render at device resolution, so blits match drawing directly
+  qreal ratio = painter->device()->devicePixelRatioF();
+  layer->image = QImage(size * ratio, QImage::Format_ARGB32_Premultiplied);
+  layer->image.setDevicePixelRatio(ratio);
+  layer->image.fill(Qt::transparent);
+  QPainter layerPainter(&layer->image);
+  layerPainter.setRenderHints(painter->renderHints());
+  drawSingleLineChart(&layerPainter, layer->image, color, stock, quote,
+                      layer->path, numberAreaWidth, 0, width - numberAreaWidth,
+                      height - pad);
+  drawSingleTextNumbers(&layerPainter, color, stock, quote, 0,
+                        numberAreaWidth, height - pad);
+  return layer->image;
+}
+
+// Bring path up to version. History is always full, so each publish shifts
+// it by one tick: new ticks are appended and the old ones are only dropped
+// from the front once they fill a second history, keeping the per-publish
+// cost proportional to the new ticks unless the price range changed.
+void LineChartMode::updatePath(ChartPath &path, const Data &numbers,
+                               uint64_t version, double ub, double diff,
+                               int width, int height) {
+  auto &points = path.points;
+  const size_t n = numbers.size();
+  double xStep = static_cast<double>(width) / (n - 1);
+  auto toY = [&](double value) { return (ub - value) / diff * height; };
+
+  uint64_t ticks = version - path.version;
+  if (path.version == 0 || version < path.version || ticks >= n ||
+      path.xStep != xStep || path.height != height ||
+      static_cast<size_t>(points.size()) - path.start != n) {
+    points.clear();
+    // Room for a second history and the two corners of the fill
+    points.reserve(2 * n + 2);
+    for (size_t i = 0; i < n; i++)
+      points.append(QPointF(i * xStep, toY(numbers[i])));
+    path = ChartPath{std::move(points), 0, version, ub, diff, xStep, height};
+    return;
+  }
+
+  if (path.ub != ub || path.diff != diff) {
+    // y' = (ub' - (ub - y / height * diff)) / diff' * height
+    double scale = path.diff / diff;
+    double offset = (ub - path.ub) / diff * height;
+    for (size_t i = path.start; i < static_cast<size_t>(points.size()); i++)
+      points[i].setY(points[i].y() * scale + offset);
+    path.ub = ub;
+    path.diff = diff;
+  }
+  for (size_t i = n - ticks; i < n; i++)
+    points.append(QPointF(points.size() * xStep, toY(numbers[i])));
+  path.start += ticks;
+  path.version = version;
+  if (path.start >= n) {
+    // Compact once per history, shifting x back to 0
+    points.remove(0, path.start);
+    path.start = 0;
+    for (int i = 0; i < points.size(); i++)
+      points[i].setX(i * xStep);
   }
 }
 
-void LineChartMode::drawSingleLineChart(QPainter *painter, const QColor &color,
-                                        const Stock *stock, int startX,
+void LineChartMode::drawSingleLineChart(QPainter *painter, QImage &image,
+                                        const QColor &color,
+                                        const Stock *stock, const Quote &quote,
+                                        ChartPath &path, int startX,
                                         int startY, int width, int height) {
-  const auto &numbers = stock->getHistroy();
-  if (numbers.empty())
+  auto numbers = stock->getHistroy();
+  if (numbers.size() < 2)
     return;
 
-  auto [min, max] = stock->getBound();
-  double baseData = stock->getBaseData();
+  auto [min, max] = Stock::getBound(numbers);
+  // Overlays on the price axis share its range
+  auto indicators = stock->getIndicators();
+  for (const auto &output : indicators) {
+    if (!output.priceScale)
+      continue;
+    for (int i = 0; i < output.seriesNum; i++) {
+      auto [sMin, sMax] = Stock::getBound(output.series[i]);
+      min = std::min(min, sMin);
+      max = std::max(max, sMax);
+    }
+  }
+  double baseData = quote.base;
   double ub = std::max(max, baseData);
   double lb = std::min(min, baseData);
   if (ub == lb) {
@@ -121,52 +344,99 @@ void LineChartMode::drawSingleLineChart(QPainter *painter, const QColor &color,
   }
   double diff = ub - lb;
 
-  double xStep = static_cast<double>(width) / (numbers.size() - 1);
+  if (softRender) {
+    // The image is in device pixels
+    qreal ratio = image.devicePixelRatio();
+    QRect rect(startX * ratio, startY * ratio, width * ratio, height * ratio);
+    QImage reference;
+    if (checkRender) {
+      // QPainter's chart on a copy of the same background
+      reference = image.copy();
+      reference.setDevicePixelRatio(ratio);
+      QPainter referencePainter(&reference);
+      referencePainter.setRenderHints(painter->renderHints());
+      drawPolygonChart(&referencePainter, color, path, numbers,
+                       stock->getVersion(), ub, diff, startX, startY, width,
+                       height);
+    }
+    drawSparkline(image, rect, numbers.linearize(), ub, diff, color.rgba());
+    if (checkRender) {
+      // Beyond the line, which is a few percent of the chart
+      int differ = countDifferentPixels(image, reference, rect, checkTolerance);
+      if (differ > rect.width() * rect.height() / 20)
+        LOG(WARNING) << "Software chart of " << stock->getCode()
+                     << " differs from QPainter in " << differ << " of "
+                     << rect.width() * rect.height() << " pixels";
+    }
+  } else {
+    drawPolygonChart(painter, color, path, numbers, stock->getVersion(), ub,
+                     diff, startX, startY, width, height);
+  }
+  drawOverlays(painter, indicators, ub, diff, startX, startY, width, height);
+}
+
+void LineChartMode::drawPolygonChart(QPainter *painter, const QColor &color,
+                                     ChartPath &path, const Data &numbers,
+                                     uint64_t version, double ub, double diff,
+                                     int startX, int startY, int width,
+                                     int height) {
+  updatePath(path, numbers, version, ub, diff, width, height);
+  auto &points = path.points;
+  const int count = points.size() - path.start;
+  const double firstX = points[path.start].x();
+
+  painter->save();
+  painter->translate(startX - firstX, startY);
 
   // Create red gradient
-  QLinearGradient gradient(startX, startY, startX, startY + height / 2);
+  QLinearGradient gradient(0, 0, 0, height / 2);
   gradient.setColorAt(0, color);            // Red, alpha=0.8
   gradient.setColorAt(1, transparentColor); // Fully transparent
 
-  // Draw gradient filled area
-  QBrush brush(gradient);
-  painter->setBrush(brush);
+  // Draw gradient filled area, the line closed along the bottom
+  painter->setBrush(QBrush(gradient));
   painter->setPen(Qt::NoPen);
-
-  // Draw region.
-  QPainterPath fillPath;
-  fillPath.moveTo(startX, startY + height);
-  for (size_t i = 0; i < numbers.size(); ++i) {
-    double x = startX + i * xStep;
-    double y = startY + ((ub - numbers[i]) / diff) * height;
-    fillPath.lineTo(x, y);
-  }
-
-  fillPath.lineTo(startX + width, startY + height);
-  fillPath.closeSubpath();
-  painter->drawPath(fillPath);
+  points.append(QPointF(points.last().x(), height));
+  points.append(QPointF(firstX, height));
+  painter->drawPolygon(points.constData() + path.start, count + 2);
+  points.resize(points.size() - 2);
 
   // Draw line
-  QPen pen(color, 1);
-  painter->setPen(pen);
+  painter->setPen(QPen(color, 1));
   painter->setBrush(Qt::NoBrush);
+  painter->drawPolyline(points.constData() + path.start, count);
+  painter->restore();
+}
 
-  QPainterPath linePath;
-  for (size_t i = 0; i < numbers.size(); ++i) {
-    double x = startX + i * xStep;
-    double y = startY + ((ub - numbers[i]) / diff) * height;
-    if (i == 0) {
-      linePath.moveTo(x, y);
-    } else {
-      linePath.lineTo(x, y);
+// Draw indicator overlays, RSI uses the full height as 0-100
+void LineChartMode::drawOverlays(QPainter *painter,
+                                 const std::vector<IndicatorOutput> &indicators,
+                                 double ub, double diff, int startX,
+                                 int startY, int width, int height) {
+  for (const auto &output : indicators) {
+    double oub = output.priceScale ? ub : 100.0;
+    double odiff = output.priceScale ? diff : 100.0;
+    painter->setPen(
+        QPen(indicatorColors[static_cast<int>(output.spec.type)], 1));
+    for (int s = 0; s < output.seriesNum; s++) {
+      const auto &series = output.series[s];
+      if (series.size() < 2)
+        continue;
+      double step = static_cast<double>(width) / (series.size() - 1);
+      overlay.resize(series.size());
+      for (size_t i = 0; i < series.size(); ++i) {
+        overlay[i] = QPointF(startX + i * step,
+                             startY + ((oub - series[i]) / odiff) * height);
+      }
+      painter->drawPolyline(overlay);
     }
   }
-  painter->drawPath(linePath);
 }
 
 void LineChartMode::drawSingleTextNumbers(QPainter *painter,
                                           const QColor &color,
-                                          const Stock *stock, int startY,
+                                          const Stock *stock,
+                                          const Quote &quote, int startY,
                                           int width, int height) {
   //  startY += height / 10;
   // Determine font size
@@ -177,41 +447,42 @@ void LineChartMode::drawSingleTextNumbers(QPainter *painter,
   int lineSpacing =
       static_cast<int>(baseFontSize * 0.3); // Compact line spacing
 
-  // Set font
   painter->setPen(QPen(color));
   painter->setBrush(Qt::NoBrush);
-  painter->setFont(QFont("Arial Narrow", baseFontSize, QFont::Bold));
 
   int curY = startY;
+  char buf[32];
   // First line: stock name
-  const auto &name = stock->getName();
-  QString nameText(QString::fromUtf8(name.data(), name.size()));
-  if (nameText.length() >= 4)
-    nameText = nameText.left(2) + "...";
-  painter->drawText(0, curY, width, baseFontSize, Qt::AlignCenter, nameText);
+  if (quote.isPending()) {
+    // Show the code and placeholders until the first fetch finishes
+    texts.drawCentered(painter, stock->getCode(), baseFontSize, 0, curY, width,
+                       baseFontSize);
+    for (int i = 0; i < 3; i++) {
+      curY += (baseFontSize + lineSpacing);
+      texts.drawCentered(painter, "--", baseFontSize, 0, curY, width,
+                         baseFontSize);
+    }
+    return;
+  }
+  texts.drawCentered(painter, shortName(stock->getName(), buf, sizeof(buf)),
+                     baseFontSize, 0, curY, width, baseFontSize);
   curY += (baseFontSize + lineSpacing);
 
   // First line: current value
-  QString currentText = QString("%1").arg(stock->getCurrentNumber(), 0, 'f', 2);
-  painter->drawText(0, curY, width, baseFontSize, Qt::AlignCenter, currentText);
+  texts.drawCentered(painter, formatNumber(buf, sizeof(buf), quote.last, 2),
+                     baseFontSize, 0, curY, width, baseFontSize);
   curY += (baseFontSize + lineSpacing);
 
   // Second line: difference
-  auto diff = stock->getDifference();
-  QString diffText = QString("%1").arg(diff, 0, 'f', 2);
-  if (diff >= 0) {
-    diffText = "+" + diffText;
-  }
-  painter->drawText(0, curY, width, baseFontSize, Qt::AlignCenter, diffText);
+  bool up = quote.diff >= 0;
+  texts.drawCentered(painter, formatNumber(buf, sizeof(buf), quote.diff, 2, up),
+                     baseFontSize, 0, curY, width, baseFontSize);
   curY += (baseFontSize + lineSpacing);
 
   // Third line: percentage
-  QString percentText =
-      QString("%1%").arg(stock->getPercentage(), 0, 'f', 2, '+');
-  if (diff >= 0) {
-    percentText = "+" + percentText;
-  }
-  painter->drawText(0, curY, width, baseFontSize, Qt::AlignCenter, percentText);
+  texts.drawCentered(painter,
+                     formatNumber(buf, sizeof(buf), quote.pct, 2, up, "%"),
+                     baseFontSize, 0, curY, width, baseFontSize);
 }
 
 bool LineChartMode::regist = DisplayMode::registCreator(
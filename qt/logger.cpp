@@ -1,10 +1,16 @@
-#include "logger.h"
-#include "utils.h"
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <string>
+#include <memory>
+#include <thread>
+
+#include "logger.h"
+#include "utils.h"
 
 static inline void localtime(time_t *now, tm *timeinfo) {
 #ifdef _WIN32
@@ -14,42 +20,240 @@ static inline void localtime(time_t *now, tm *timeinfo) {
 #endif
 }
 
-static inline void getCurrentTime(char *buffer, size_t len) {
-  time_t now = time(nullptr);
-  struct tm timeinfo;
-  localtime(&now, &timeinfo);
-  strftime(buffer, len, "[%Y-%m-%d %H:%M:%S]", &timeinfo);
-  return;
-}
-
 constexpr std::array<const char *, 5> levelStr = {
     "[DEBUG]", "[INFO]", "[WARNING]", "[ERROR]", "[FATAL]"};
 
-Logger::Logger(LogLevel level) : level_(level) {
-  char time[80];
-  getCurrentTime(time, sizeof(time));
-  *this << time << levelStr[static_cast<int>(level)];
-}
+namespace {
 
-Logger::~Logger() {
-  if (level_ == LogLevel::DEBUG) {
-#ifdef NDEBUG
-    return;
-#endif
-    try {
-      static bool isdebug;
-      isdebug = getenv<bool>("MONITOR_DEBUG");
-      if (!isdebug)
+struct LogRecord {
+  LogLevel level;
+  int64_t time;
+  size_t size;
+  char text[Logger::kMaxMessage];
+};
+
+// Bounded multi-producer queue of preallocated records. Each cell carries a
+// sequence telling whether it is free for the producer of a position or full
+// for the consumer, so producers claim cells with one CAS and never wait for
+// each other.
+class LogQueue {
+public:
+  static constexpr size_t kCapacity = 1024; // A power of two
+
+  LogQueue() : cells(new Cell[kCapacity]) {
+    for (size_t i = 0; i < kCapacity; i++)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  // Return false if the queue is full.
+  bool push(LogLevel level, int64_t time, const char *text, size_t size) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells[pos & (kCapacity - 1)];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      if (seq == pos) {
+        if (tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed))
+          break;
+      } else if (seq < pos) {
+        return false;
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    Cell &cell = cells[pos & (kCapacity - 1)];
+    // Only the used part of the text
+    cell.record.level = level;
+    cell.record.time = time;
+    cell.record.size = size;
+    memcpy(cell.record.text, text, size);
+    cell.seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Single consumer. Return nullptr if the next record is not ready, else
+  // the record, valid until pop().
+  const LogRecord *front() {
+    Cell &cell = cells[head & (kCapacity - 1)];
+    if (cell.seq.load(std::memory_order_acquire) != head + 1)
+      return nullptr;
+    return &cell.record;
+  }
+  void pop() {
+    cells[head & (kCapacity - 1)].seq.store(head + kCapacity,
+                                            std::memory_order_release);
+    head++;
+  }
+
+private:
+  struct alignas(64) Cell {
+    std::atomic<size_t> seq;
+    LogRecord record;
+  };
+  std::unique_ptr<Cell[]> cells;
+  alignas(64) std::atomic<size_t> tail{0};
+  alignas(64) size_t head = 0;
+};
+
+// Background thread writing queued records. Never destroyed, so messages
+// logged from static destructors stay safe; at exit the thread drains the
+// queue and later messages are written directly.
+class LogSink {
+public:
+  static LogSink &instance() {
+    static LogSink *sink = new LogSink;
+    return *sink;
+  }
+
+  void submit(LogLevel level, int64_t time, const char *text, size_t size) {
+    if (!running.load(std::memory_order_acquire)) {
+      writeNow(level, time, text, size);
+      return;
+    }
+    while (!queue.push(level, time, text, size)) {
+      // Chatter is dropped and counted rather than blocking the caller,
+      // warnings and errors wait for the sink
+      if (level < LogLevel::WARNING) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
         return;
-    } catch (const std::unset_env &e) {
+      }
+      std::this_thread::yield();
+    }
+    pushed.fetch_add(1, std::memory_order_release);
+    pushed.notify_one();
+  }
+
+  // Write a record directly, after the queued ones.
+  void writeNow(LogLevel level, int64_t time, const char *text, size_t size) {
+    flush();
+    char buf[32];
+    FILE *file = level == LogLevel::INFO ? stdout : stderr;
+    fprintf(file, "%s%s%.*s\n", formatTime(time, buf, sizeof(buf)),
+            levelStr[static_cast<int>(level)], int(size), text);
+    fflush(file);
+  }
+
+  void flush() {
+    if (!running.load(std::memory_order_acquire))
       return;
+    uint32_t target = pushed.load(std::memory_order_acquire);
+    while (int32_t(written.load(std::memory_order_acquire) - target) < 0)
+      std::this_thread::yield();
+  }
+
+private:
+  LogQueue queue;
+  std::atomic<uint32_t> pushed{0};  // Records queued, the futex word
+  std::atomic<uint32_t> written{0}; // Records written by the sink
+  std::atomic<uint32_t> dropped{0};
+  std::atomic<bool> running{true};
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+  time_t stampTime = -1; // Second of the cached stamp
+  char stamp[32];
+
+  LogSink() : thread([this]() { run(); }) {
+    std::atexit([]() { instance().stop(); });
+  }
+
+  void stop() {
+    stopping.store(true, std::memory_order_release);
+    pushed.fetch_add(1, std::memory_order_release);
+    pushed.notify_one();
+    thread.join();
+    running.store(false, std::memory_order_release);
+    // Records pushed while the thread exited
+    drain();
+  }
+
+  void run() {
+    for (;;) {
+      uint32_t seen = pushed.load(std::memory_order_acquire);
+      if (!drain()) {
+        if (stopping.load(std::memory_order_acquire))
+          return;
+        pushed.wait(seen, std::memory_order_acquire);
+      }
+    }
+  }
+
+  // Write every ready record, return false if there was none.
+  bool drain() {
+    uint32_t count = 0;
+    bool out = false, err = false;
+    while (const LogRecord *record = queue.front()) {
+      write(*record);
+      (record->level == LogLevel::INFO ? out : err) = true;
+      queue.pop();
+      count++;
+    }
+    if (uint32_t lost = dropped.exchange(0, std::memory_order_relaxed)) {
+      fprintf(stderr, "[WARNING]logger: %u messages dropped\n", lost);
+      err = true;
+    }
+    // One flush per batch, stdout is fully buffered when redirected
+    if (out)
+      fflush(stdout);
+    if (err)
+      fflush(stderr);
+    written.fetch_add(count, std::memory_order_release);
+    return count != 0;
+  }
+
+  static const char *formatTime(int64_t time, char *buf, size_t len) {
+    time_t seconds = time_t(time / 1000000000);
+    struct tm timeinfo;
+    localtime(&seconds, &timeinfo);
+    strftime(buf, len, "[%Y-%m-%d %H:%M:%S]", &timeinfo);
+    return buf;
+  }
+
+  void write(const LogRecord &record) {
+    // Messages mostly come in bursts within a second
+    time_t seconds = time_t(record.time / 1000000000);
+    if (seconds != stampTime) {
+      formatTime(record.time, stamp, sizeof(stamp));
+      stampTime = seconds;
     }
+    FILE *file = record.level == LogLevel::INFO ? stdout : stderr;
+    fprintf(file, "%s%s%.*s\n", stamp,
+            levelStr[static_cast<int>(record.level)], int(record.size),
+            record.text);
   }
+};
+
+} // namespace
+
+Logger::Logger(LogLevel level, const char *file, int line,
+               std::string_view tag)
+    : level(level),
+      time(std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+               .count()) {
+  if (!tag.empty())
+    *this << '[' << tag << ']';
+  *this << file << '(' << line << "):";
+}
 
-  if (level_ == LogLevel::INFO)
-    fprintf(stdout, "%s\n", this->str().c_str());
-  else
-    fprintf(stderr, "%s\n", this->str().c_str());
-  if (level_ == LogLevel::FATAL)
+Logger::~Logger() {
+  LogSink &sink = LogSink::instance();
+  if (level == LogLevel::FATAL) {
+    sink.writeNow(level, time, text, size);
     std::abort();
+  }
+  sink.submit(level, time, text, size);
+}
+
+bool Logger::debugEnabled() {
+  try {
+    return getenv<bool>("MONITOR_DEBUG");
+  } catch (const std::unset_env &e) {
+    return false;
+  }
+}
+
+void Logger::append(const char *data, size_t len) {
+  len = std::min(len, kMaxMessage - size);
+  memcpy(text + size, data, len);
+  size += len;
 }
@@ -1,28 +1,103 @@
 #ifndef LOGGER_H
 #define LOGGER_H
-#include <filesystem> // IWYU pragma: keep
-#include <sstream>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
 
 // 日志级别枚举
 enum class LogLevel { DEBUG, INFO, WARNING, ERROR, FATAL };
 
-class Logger : public std::ostringstream {
-private:
-  LogLevel level_; // log level
+// Levels below this are compiled out, set with -DMONITOR_LOG_LEVEL=<0..4>.
+// Release builds drop DEBUG by default.
+#ifndef MONITOR_LOG_LEVEL
+#ifdef NDEBUG
+#define MONITOR_LOG_LEVEL 1
+#else
+#define MONITOR_LOG_LEVEL 0
+#endif
+#endif
+constexpr LogLevel kMinLogLevel = static_cast<LogLevel>(MONITOR_LOG_LEVEL);
+
+// Base name of a __FILE__ path, computed by the compiler.
+consteval const char *fileName(const char *path) {
+  const char *name = path;
+  for (const char *p = path; *p; p++) {
+    if (*p == '/' || *p == '\\')
+      name = p + 1;
+  }
+  return name;
+}
 
+// One log message, formatted into a fixed buffer on the stack and handed to
+// a background sink thread through a lock-free queue when destroyed. Longer
+// messages are cut. Use it through LOG and DBG, which skip the formatting of
+// disabled levels.
+class Logger {
 public:
-  explicit Logger(LogLevel level);
-  ~Logger() override;
+  static constexpr size_t kMaxMessage = 480;
+
+  // Tag, if any, is written as "[tag]" before the location.
+  Logger(LogLevel level, const char *file, int line, std::string_view tag = {});
+  ~Logger();
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  // Runtime filter: DEBUG only with MONITOR_DEBUG=1, read once.
+  static bool enabled(LogLevel level) {
+    static const bool debug = debugEnabled();
+    return level != LogLevel::DEBUG || debug;
+  }
+
+  Logger &operator<<(std::string_view s) {
+    append(s.data(), s.size());
+    return *this;
+  }
+  Logger &operator<<(const char *s) { return *this << std::string_view(s); }
+  Logger &operator<<(char c) {
+    append(&c, 1);
+    return *this;
+  }
+  Logger &operator<<(bool b) { return *this << (b ? "true" : "false"); }
+  template <std::integral T> Logger &operator<<(T value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    append(buf, result.ptr - buf);
+    return *this;
+  }
+  // Six significant digits, like std::ostream
+  template <std::floating_point T> Logger &operator<<(T value) {
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value,
+                                std::chars_format::general, 6);
+    append(buf, result.ptr - buf);
+    return *this;
+  }
+
+private:
+  LogLevel level;
+  int64_t time; // Nanoseconds since epoch, formatted by the sink
+  size_t size = 0;
+  char text[kMaxMessage];
+
+  static bool debugEnabled();
+  void append(const char *data, size_t len);
+};
+
+// Turns the stream expression into void for the conditional in LOG.
+struct LogVoidify {
+  void operator&(Logger &) {}
 };
 
+#define LOG_IF_ENABLED(level)                                                  \
+  !(level >= kMinLogLevel && Logger::enabled(level)) ? (void)0 : LogVoidify() &
+
 #define LOG(level)                                                             \
-  Logger(LogLevel::level)                                                      \
-      << std::filesystem::path(__FILE__).filename().c_str() << "(" << __LINE__ \
-      << "):"
-#endif // LOGGER_H
+  LOG_IF_ENABLED(LogLevel::level)                                              \
+  Logger(LogLevel::level, fileName(__FILE__), __LINE__)
 
 #define DBG()                                                                  \
-  Logger(LogLevel::DEBUG)                                                      \
-      << "[" << (DEBUG_TYPE) << "]"                                            \
-      << std::filesystem::path(__FILE__).filename().c_str() << "(" << __LINE__ \
-      << "):"
+  LOG_IF_ENABLED(LogLevel::DEBUG)                                              \
+  Logger(LogLevel::DEBUG, fileName(__FILE__), __LINE__, DEBUG_TYPE)
+#endif // LOGGER_H
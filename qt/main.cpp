@@ -2,23 +2,28 @@
 #include <optional>
 
 #include "config_parser.h"
+#include "metrics_server.h"
 #include "widget.h"
 
 #include <QApplication>
+#include <QString>
 
 int main(int argc, char *argv[]) {
   QApplication app(argc, argv);
 
   ConfigData config;
+  QString configPath;
 
   if (argc == 2) {
     std::ifstream fin(argv[1]);
     auto configIn = parseConfig(fin);
     if (configIn.has_value())
       config = *configIn;
+    configPath = QString::fromLocal8Bit(argv[1]);
   }
-  Widget widget(config);
+  Widget widget(config, configPath);
   widget.show();
+  startMetricsServer();
 
   return app.exec();
 }
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "logger.h"
+#include "market_clock.h"
+#include "utils.h"
+
+#include <QString>
+#include <QTime>
+
+// A simulated day runs from a little before the open to after the close
+static const QTime kDayBegin(9, 25);
+static const QTime kDayEnd(15, 5);
+
+void MarketClock::start(QTimer &timer, int64_t interval) const {
+  timer.start(static_cast<int>(realInterval(interval)));
+}
+
+// "<local ISO time>[,speed]", the wall clock if unset or invalid
+static std::unique_ptr<MarketClock> clockFromEnv() {
+  std::string value;
+  try {
+    value = getenv<std::string>("MONITOR_CLOCK");
+  } catch (const std::unset_env &e) {
+    return std::make_unique<WallClock>();
+  }
+  std::string_view time = value, speedStr;
+  if (size_t comma = value.find(','); comma != std::string::npos) {
+    time = time.substr(0, comma);
+    speedStr = std::string_view(value).substr(comma + 1);
+  }
+  QDateTime start = QDateTime::fromString(
+      QString::fromUtf8(time.data(), int(time.size())), Qt::ISODate);
+  double speed = 1.0;
+  try {
+    if (!speedStr.empty())
+      speed = std::stod(std::string(speedStr));
+  } catch (const std::exception &e) {
+    speed = 0.0;
+  }
+  if (!start.isValid() || speed <= 0.0) {
+    LOG(ERROR) << "MONITOR_CLOCK must be '<time>[,speed]', e.g. "
+                  "'2026-03-20T09:25,600', got '"
+               << value << "'";
+    return std::make_unique<WallClock>();
+  }
+  LOG(INFO) << "Simulated clock from " << time << " at " << speed << "x";
+  return std::make_unique<SimulatedClock>(start.toMSecsSinceEpoch(), speed);
+}
+
+static std::unique_ptr<MarketClock> &currentClock() {
+  static std::unique_ptr<MarketClock> clock = clockFromEnv();
+  return clock;
+}
+
+MarketClock &MarketClock::instance() { return *currentClock(); }
+
+void MarketClock::install(std::unique_ptr<MarketClock> clock) {
+  currentClock() = std::move(clock);
+}
+
+int64_t WallClock::now() const { return QDateTime::currentMSecsSinceEpoch(); }
+
+SimulatedClock::SimulatedClock(int64_t start, double speed)
+    : speed(speed), realStart(std::chrono::steady_clock::now()),
+      dayElapsed(0) {
+  beginDay(start);
+}
+
+void SimulatedClock::beginDay(int64_t t) const {
+  QDateTime time = QDateTime::fromMSecsSinceEpoch(t);
+  dayStart = t;
+  dayLength = std::max<int64_t>(
+      time.msecsTo(QDateTime(time.date(), kDayEnd)), 0);
+}
+
+int64_t SimulatedClock::now() const {
+  auto real = std::chrono::steady_clock::now() - realStart;
+  auto elapsed = int64_t(
+      std::chrono::duration<double, std::milli>(real).count() * speed);
+  std::lock_guard lock(mutex);
+  while (elapsed - dayElapsed >= dayLength) {
+    // Skip to the next weekday, holidays are not known
+    dayElapsed += dayLength;
+    QDate next = QDateTime::fromMSecsSinceEpoch(dayStart).date().addDays(1);
+    while (next.dayOfWeek() == Qt::Saturday || next.dayOfWeek() == Qt::Sunday)
+      next = next.addDays(1);
+    beginDay(QDateTime(next, kDayBegin).toMSecsSinceEpoch());
+  }
+  return dayStart + (elapsed - dayElapsed);
+}
+
+int64_t SimulatedClock::realInterval(int64_t interval) const {
+  return std::max<int64_t>(int64_t(interval / speed), 1);
+}
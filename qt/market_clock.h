@@ -0,0 +1,67 @@
+#ifndef MARKET_CLOCK_H
+#define MARKET_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <QDate>
+#include <QDateTime>
+#include <QTimer>
+
+// Time as seen by session checks, contract rolls, quote timestamps and the
+// fetch timers. The wall clock by default; MONITOR_CLOCK installs a
+// SimulatedClock, e.g. "2026-03-20T09:25,600" runs the day of a quarterly
+// roll from 09:25 at 600 times the real speed, its session and lunch break
+// in about half a minute. Pair it with test codes, or with the daemon
+// replaying quotes, to soak or profile whole days.
+class MarketClock {
+public:
+  virtual ~MarketClock() = default;
+
+  // Milliseconds since epoch, thread safe.
+  virtual int64_t now() const = 0;
+  // Real milliseconds that interval milliseconds of this clock take.
+  virtual int64_t realInterval(int64_t interval) const = 0;
+
+  QDateTime dateTime() const { return QDateTime::fromMSecsSinceEpoch(now()); }
+  QDate date() const { return dateTime().date(); }
+  // Start timer to fire every interval milliseconds of this clock.
+  void start(QTimer &timer, int64_t interval) const;
+
+  // The clock of MONITOR_CLOCK, created on first use.
+  static MarketClock &instance();
+  // Replace the clock, before anything reads the time.
+  static void install(std::unique_ptr<MarketClock> clock);
+};
+
+class WallClock : public MarketClock {
+public:
+  int64_t now() const override;
+  int64_t realInterval(int64_t interval) const override { return interval; }
+};
+
+// Runs speed times faster than the wall clock from start. Past 15:05 it
+// jumps to 09:25 of the next weekday, so nights and weekends take no time
+// and runs of several days cross their contract rolls.
+class SimulatedClock : public MarketClock {
+public:
+  SimulatedClock(int64_t start, double speed);
+  int64_t now() const override;
+  int64_t realInterval(int64_t interval) const override;
+
+private:
+  const double speed;
+  const std::chrono::steady_clock::time_point realStart;
+  // Day being run, advanced as time passes it
+  mutable std::mutex mutex;
+  mutable int64_t dayStart;   // Simulated time the day began at
+  mutable int64_t dayLength;  // Until it ends
+  mutable int64_t dayElapsed; // Simulated time run before the day
+
+  // Set the day from time t to its end
+  void beginDay(int64_t t) const;
+};
+
+#endif // MARKET_CLOCK_H
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <numbers>
+#include <string>
+
+#include "logger.h"
+#include "market_clock.h"
+#include "market_simulator.h"
+#include "utils.h"
+
+#if defined(__GNUC__)
+// Two lanes, one SSE2/NEON register. Wider vectors would be passed between
+// the helpers below differently with and without AVX.
+typedef double Double2 __attribute__((vector_size(2 * sizeof(double))));
+typedef uint64_t U64x2 __attribute__((vector_size(2 * sizeof(uint64_t))));
+typedef int64_t I64x2 __attribute__((vector_size(2 * sizeof(int64_t))));
+#endif
+
+namespace {
+
+constexpr uint64_t kMarketKey = 0x6D61726B6574;     // Market factor
+constexpr uint64_t kSectorKey = 0x736563746F72;     // Plus the sector
+constexpr uint64_t kEventSalt = 0x4556454E54533031; // Gap draws
+constexpr uint64_t kOpenStep = UINT64_MAX;          // Draws of the open
+constexpr double kSectorWeight = 0.4;
+constexpr double kGapRate = 1e-4;       // Per symbol and step
+constexpr double kMarketGapRate = 2e-5; // Per step
+constexpr double kGap = 0.05;
+constexpr double kMarketGap = 0.03;
+constexpr double kLimit = 0.10; // Daily price limit
+constexpr double kSessionSeconds = 4 * 3600;
+constexpr int64_t kMaxGap = 10 * 60 * 1000; // ms
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+  return x ^ (x >> 31);
+}
+
+// Random bits of key at step, a pure function so any step of any symbol is
+// drawn in any order
+uint64_t draw(uint64_t seed, uint64_t key, uint64_t step) {
+  return mix(seed ^ mix(key ^ mix(step)));
+}
+
+// In (0, 1]
+double uniform(uint64_t bits) { return double((bits >> 11) + 1) * 0x1.0p-53; }
+
+#if defined(__GNUC__)
+// libm calls keep a loop scalar, so the draws of two symbols are made with
+// polynomials in vector registers instead. Errors are below 1e-12.
+
+U64x2 mixLanes(U64x2 x) {
+  x += 0x9E3779B97F4A7C15;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EB;
+  return x ^ (x >> 31);
+}
+
+// 1.0 where mask is set, else 0.0
+Double2 selectLanes(I64x2 mask) {
+  return __builtin_convertvector(-mask, Double2);
+}
+
+// Natural log of normal x > 0, x = m * 2^e with m in [sqrt(1/2), sqrt(2)),
+// log(m) = 2 atanh(s) for s = (m - 1) / (m + 1)
+Double2 logLanes(Double2 x) {
+  U64x2 bits;
+  memcpy(&bits, &x, sizeof(bits));
+  I64x2 e = (I64x2)((bits >> 52) & 0x7FF) - 1023;
+  bits = (bits & 0x000FFFFFFFFFFFFF) | 0x3FF0000000000000;
+  Double2 m;
+  memcpy(&m, &bits, sizeof(m));
+  Double2 big = selectLanes(m > std::numbers::sqrt2);
+  m *= 1.0 - 0.5 * big;
+  Double2 s = (m - 1.0) / (m + 1.0);
+  Double2 s2 = s * s;
+  Double2 p = Double2{} + 1.0 / 13;
+  for (double c : {1.0 / 11, 1.0 / 9, 1.0 / 7, 1.0 / 5, 1.0 / 3, 1.0})
+    p = p * s2 + c;
+  return (__builtin_convertvector(e, Double2) + big) * std::numbers::ln2 +
+         2.0 * s * p;
+}
+
+// cos(2 pi t) for t in [0, 1), reduced by symmetry to a quarter turn
+Double2 cosTurnLanes(Double2 t) {
+  Double2 y = t - selectLanes(t >= 0.5);            // [-0.5, 0.5)
+  Double2 a = y * (1.0 - 2.0 * selectLanes(y < 0)); // |y|
+  Double2 flip = selectLanes(a > 0.25);
+  Double2 z = 2.0 * std::numbers::pi * (a + flip * (0.5 - 2.0 * a));
+  Double2 z2 = z * z;
+  // Taylor series to z^20, z <= pi/2
+  Double2 p = Double2{} + 1.0 / 2432902008176640000.0;
+  for (double c : {-1.0 / 6402373705728000.0, 1.0 / 20922789888000.0,
+                   -1.0 / 87178291200.0, 1.0 / 479001600.0, -1.0 / 3628800.0,
+                   1.0 / 40320.0, -1.0 / 720.0, 1.0 / 24.0, -1.0 / 2.0, 1.0})
+    p = p * z2 + c;
+  return (1.0 - 2.0 * flip) * p;
+}
+
+// Standard normals by Box-Muller over the two halves of bits
+Double2 normalLanes(U64x2 bits) {
+  Double2 u1 = __builtin_convertvector((bits >> 32) + 1, Double2) * 0x1.0p-32;
+  Double2 u2 = __builtin_convertvector(bits & 0xFFFFFFFF, Double2) * 0x1.0p-32;
+  Double2 r = -2.0 * logLanes(u1);
+  for (int k = 0; k < 2; k++)
+    r[k] = std::sqrt(r[k]);
+  return r * cosTurnLanes(u2);
+}
+
+// The same generator for single draws, so paths do not depend on which one
+// a number comes from
+double normal(uint64_t bits) {
+  return normalLanes(U64x2{bits, bits})[0];
+}
+#else
+// Standard normal by Box-Muller over the two halves of bits
+double normal(uint64_t bits) {
+  double u1 = double((bits >> 32) + 1) * 0x1.0p-32;
+  double u2 = double(bits & 0xFFFFFFFF) * 0x1.0p-32;
+  return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * std::numbers::pi * u2);
+}
+#endif
+
+// FNV-1a, stable across runs unlike std::hash
+uint64_t hashCode(const std::string &code) {
+  uint64_t h = 0xCBF29CE484222325;
+  for (unsigned char c : code)
+    h = (h ^ c) * 0x100000001B3;
+  return h;
+}
+
+double roundCent(double price) { return std::round(price * 100.0) / 100.0; }
+
+} // namespace
+
+MarketSimulator &MarketSimulator::instance() {
+  static MarketSimulator simulator([]() {
+    Options options;
+    try {
+      options.seed = getenv<int64_t>("MONITOR_SIM_SEED");
+    } catch (const std::unset_env &e) {
+    } catch (const std::exception &e) {
+      LOG(ERROR) << e.what();
+    }
+    try {
+      options.tickInterval = std::max<int64_t>(
+          getenv<int64_t>("MONITOR_SIM_TICK"), 0);
+    } catch (const std::unset_env &e) {
+    } catch (const std::exception &e) {
+      LOG(ERROR) << e.what();
+    }
+    return options;
+  }());
+  return simulator;
+}
+
+MarketSimulator::MarketSimulator(const Options &options)
+    : options(options), start(MarketClock::instance().now()) {
+  // A step of a fetch cycle stands for the 3s of an exchange snapshot
+  double seconds =
+      options.tickInterval > 0 ? options.tickInterval / 1000.0 : 3.0;
+  stepSigma = std::sqrt(seconds / kSessionSeconds);
+}
+
+uint32_t MarketSimulator::add(SymbolId id) {
+  constexpr uint32_t kNone = UINT32_MAX;
+  if (id < indexOf.size() && indexOf[id] != kNone)
+    return indexOf[id];
+  if (id >= indexOf.size())
+    indexOf.resize(id + 1, kNone);
+  uint32_t index = static_cast<uint32_t>(ids.size());
+  indexOf[id] = index;
+
+  uint64_t key = hashCode(symbolCode(id));
+  uint64_t h = mix(options.seed ^ key);
+  // Log uniform prices of 3 to 300, daily volatility of 1.5% to 4%
+  double base = roundCent(3.0 * std::exp(uniform(h) * std::log(100.0)));
+  double open = base * std::exp(
+                           0.01 * normal(draw(options.seed, key, kOpenStep)) +
+                           0.005 * normal(draw(options.seed, kMarketKey,
+                                               kOpenStep)));
+  ids.push_back(id);
+  keys.push_back(key);
+  sectors.push_back(static_cast<uint8_t>((h >> 8) % kSectors));
+  betas.push_back(0.3 + 0.5 * uniform(mix(h)));
+  sigmas.push_back((0.015 + 0.025 * uniform(mix(h + 1))) * stepSigma);
+  bases.push_back(base);
+  opens.push_back(roundCent(std::clamp(open, base * (1 - kLimit),
+                                       base * (1 + kLimit))));
+  prices.push_back(opens.back());
+  volumes.push_back(0.0);
+  turnovers.push_back(0.0);
+  quoted.push_back(UINT64_MAX);
+  noise.resize(ids.size());
+  events.resize(ids.size());
+
+  // Same path as if it was there from the start
+  for (uint64_t t = 0; t < step; t++)
+    stepRange(t, index, index + 1);
+  return index;
+}
+
+void MarketSimulator::stepRange(uint64_t t, size_t begin, size_t end) {
+  const uint64_t seed = options.seed;
+  double market = normal(draw(seed, kMarketKey, t));
+  double sectorMoves[kSectors];
+  for (int s = 0; s < kSectors; s++)
+    sectorMoves[s] = normal(draw(seed, kSectorKey + s, t));
+  uint64_t marketEvent = draw(seed, kMarketKey ^ kEventSalt, t);
+  double marketJump = uniform(marketEvent) < kMarketGapRate
+                          ? (marketEvent & 1 ? kMarketGap : -kMarketGap)
+                          : 0.0;
+
+  // Draws of all symbols first, over flat arrays
+#if defined(__GNUC__)
+  // Two symbols at a time. The last block is padded rather than finished
+  // by scalar code, every symbol takes the same arithmetic wherever its
+  // block starts.
+  const uint64_t stepBits = mix(t);
+  for (size_t i = begin; i < end; i += 2) {
+    size_t n = std::min<size_t>(end - i, 2);
+    U64x2 key{};
+    memcpy(&key, keys.data() + i, n * sizeof(uint64_t));
+    Double2 z = normalLanes(mixLanes(seed ^ mixLanes(key ^ stepBits)));
+    U64x2 event = mixLanes(seed ^ mixLanes((key ^ kEventSalt) ^ stepBits));
+    Double2 u =
+        __builtin_convertvector((event >> 11) + 1, Double2) * 0x1.0p-53;
+    memcpy(noise.data() + i, &z, n * sizeof(double));
+    memcpy(events.data() + i, &u, n * sizeof(double));
+  }
+#else
+  for (size_t i = begin; i < end; i++) {
+    noise[i] = normal(draw(seed, keys[i], t));
+    events[i] = uniform(draw(seed, keys[i] ^ kEventSalt, t));
+  }
+#endif
+  for (size_t i = begin; i < end; i++) {
+    double beta = betas[i];
+    double idio = std::sqrt(1.0 - beta * beta - kSectorWeight * kSectorWeight);
+    double jump = events[i] < kGapRate
+                      ? (events[i] < kGapRate / 2 ? -kGap : kGap)
+                      : 0.0;
+    double r = sigmas[i] * (beta * market +
+                            kSectorWeight * sectorMoves[sectors[i]] +
+                            idio * noise[i]) +
+               beta * marketJump + jump;
+    double limitDown = roundCent(bases[i] * (1 - kLimit));
+    double limitUp = roundCent(bases[i] * (1 + kLimit));
+    double price = std::clamp(prices[i] * std::exp(r), limitDown, limitUp);
+    // Trading dries up at a limit
+    bool locked = price == limitDown || price == limitUp;
+    double lot =
+        100.0 * std::floor(1.0 + std::abs(noise[i]) * (locked ? 2.0 : 50.0));
+    prices[i] = price;
+    volumes[i] += lot;
+    turnovers[i] += lot * price;
+  }
+}
+
+void MarketSimulator::advanceTo(uint64_t target) {
+  for (; step < target; step++)
+    stepRange(step, 0, ids.size());
+}
+
+StockInfo MarketSimulator::quote(uint32_t index) {
+  if (options.tickInterval > 0) {
+    int64_t now = MarketClock::instance().now();
+    // A clock stepping back before start, e.g. an NTP correction, waits
+    uint64_t target =
+        now > start ? uint64_t(now - start) / options.tickInterval : step;
+    // Nothing is fetched this long only while the market is closed, e.g.
+    // lunch or the nights a simulated clock skips, prices wait for it
+    if (int64_t(target - step) * options.tickInterval > kMaxGap) {
+      start += int64_t(target - step) * options.tickInterval;
+      target = step;
+    }
+    advanceTo(target);
+  } else if (quoted[index] == step) // Quoted again, a new fetch cycle
+    advanceTo(step + 1);
+  quoted[index] = step;
+  return StockInfo{.name = symbolCode(ids[index]),
+                   .curPrice = roundCent(prices[index]),
+                   .yesterdayPrice = bases[index],
+                   .openPrice = opens[index],
+                   .volume = volumes[index],
+                   .turnover = turnovers[index]};
+}
@@ -0,0 +1,72 @@
+#ifndef MARKET_SIMULATOR_H
+#define MARKET_SIMULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "stock_fetcher.h"
+#include "symbol_table.h"
+
+// Seeded market behind the "test*" codes, for offline load tests. Returns of
+// a step mix a market factor, one of eight sector factors and noise of the
+// symbol, so simulated stocks move together. Gaps open the session and hit
+// single symbols or the whole market at random steps, and prices stop at the
+// limits of +-10% from the previous close.
+//
+// Every random number is a hash of the seed, the symbol and the step, so the
+// path of a symbol depends only on them: not on the other symbols, nor when
+// it was added. Steps update all symbols at once over flat arrays.
+class MarketSimulator {
+public:
+  struct Options {
+    uint64_t seed = 1;
+    // MarketClock milliseconds per step, 0 steps once per fetch cycle
+    int64_t tickInterval = 0;
+  };
+
+  // Simulator of MONITOR_SIM_SEED and MONITOR_SIM_TICK.
+  static MarketSimulator &instance();
+  explicit MarketSimulator(const Options &options);
+  MarketSimulator(const MarketSimulator &) = delete;
+  MarketSimulator &operator=(const MarketSimulator &) = delete;
+
+  // Index of the symbol, added and brought to the current step if new.
+  uint32_t add(SymbolId id);
+  // Quote of a symbol at the current step, advancing by the tick rate.
+  StockInfo quote(uint32_t index);
+  // Run every symbol up to step.
+  void advanceTo(uint64_t step);
+  uint64_t getStep() const { return step; }
+  size_t size() const { return ids.size(); }
+
+private:
+  static constexpr int kSectors = 8;
+
+  Options options;
+  int64_t start;     // MarketClock ms of step 0, moved past closed gaps
+  double stepSigma;  // Volatility of a step relative to a session
+  uint64_t step = 0; // Steps done by all symbols
+
+  // Per symbol, structure of arrays
+  std::vector<SymbolId> ids;
+  std::vector<uint64_t> keys; // Hash of the code
+  std::vector<uint8_t> sectors;
+  std::vector<double> sigmas;
+  std::vector<double> betas;
+  std::vector<double> prices;
+  std::vector<double> bases; // Close of the previous day
+  std::vector<double> opens;
+  std::vector<double> volumes;
+  std::vector<double> turnovers;
+  std::vector<uint64_t> quoted; // Step of the last quote, fetch cycle ticks
+  std::vector<uint32_t> indexOf; // Symbol id -> index
+  // Scratch of a step
+  std::vector<double> noise;
+  std::vector<double> events;
+
+  // Advance symbols [begin, end) from step t to t + 1
+  void stepRange(uint64_t t, size_t begin, size_t end);
+};
+
+#endif // MARKET_SIMULATOR_H
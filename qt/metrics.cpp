@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+#include "metrics.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace metrics {
+
+size_t assignShard() {
+  static std::atomic<size_t> next{0};
+  return next.fetch_add(1, std::memory_order_relaxed) % kShards;
+}
+
+uint64_t Counter::value() const {
+  uint64_t sum = 0;
+  for (const auto &shard : shards)
+    sum += shard.value.load(std::memory_order_relaxed);
+  return sum;
+}
+
+Histogram::Histogram(std::initializer_list<double> bounds)
+    : bounds(bounds.begin(),
+             bounds.begin() + std::min(bounds.size(), kMaxBuckets)) {}
+
+void Histogram::observe(double v) {
+  size_t bucket = 0;
+  while (bucket < bounds.size() && v > bounds[bucket])
+    bucket++;
+  Shard &shard = shards[shardIndex()];
+  shard.counts[bucket].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(v, std::memory_order_relaxed);
+}
+
+void Histogram::expose(std::string &out, std::string_view name,
+                       std::string_view labels) const {
+  std::string bucketName = std::string(name) + "_bucket";
+  std::string le;
+  uint64_t count = 0;
+  double sum = 0;
+  for (const auto &shard : shards)
+    sum += shard.sum.load(std::memory_order_relaxed);
+  for (size_t i = 0; i <= bounds.size(); i++) {
+    for (const auto &shard : shards)
+      count += shard.counts[i].load(std::memory_order_relaxed);
+    le = labels;
+    if (!le.empty())
+      le += ',';
+    le += "le=\"";
+    if (i < bounds.size()) {
+      char buf[32];
+      auto result = std::to_chars(buf, buf + sizeof(buf), bounds[i]);
+      le.append(buf, result.ptr);
+    } else {
+      le += "+Inf";
+    }
+    le += '"';
+    appendSample(out, bucketName, le, count);
+  }
+  appendSample(out, std::string(name) + "_sum", labels, sum);
+  appendSample(out, std::string(name) + "_count", labels, count);
+}
+
+Registry &Registry::instance() {
+  static Registry *registry = new Registry;
+  return *registry;
+}
+
+Registry::Family &Registry::family(std::string_view name,
+                                   std::string_view help, const char *type) {
+  auto it = families.find(name);
+  if (it == families.end())
+    it = families
+             .emplace(std::string(name),
+                      Family{std::string(help), type, {}, {}, {}})
+             .first;
+  return it->second;
+}
+
+Counter &Registry::counter(std::string_view name, std::string_view help,
+                           std::string_view labels) {
+  std::lock_guard lock(mutex);
+  auto &metric = family(name, help, "counter").counters[std::string(labels)];
+  if (!metric)
+    metric = std::make_unique<Counter>();
+  return *metric;
+}
+
+Gauge &Registry::gauge(std::string_view name, std::string_view help,
+                       std::string_view labels) {
+  std::lock_guard lock(mutex);
+  auto &metric = family(name, help, "gauge").gauges[std::string(labels)];
+  if (!metric)
+    metric = std::make_unique<Gauge>();
+  return *metric;
+}
+
+Histogram &Registry::histogram(std::string_view name, std::string_view help,
+                               std::initializer_list<double> bounds,
+                               std::string_view labels) {
+  std::lock_guard lock(mutex);
+  auto &metric =
+      family(name, help, "histogram").histograms[std::string(labels)];
+  if (!metric)
+    metric = std::make_unique<Histogram>(bounds);
+  return *metric;
+}
+
+int Registry::addCollector(std::function<void(std::string &)> collector) {
+  std::lock_guard lock(mutex);
+  collectors.emplace(nextCollector, std::move(collector));
+  return nextCollector++;
+}
+
+void Registry::removeCollector(int id) {
+  std::lock_guard lock(mutex);
+  collectors.erase(id);
+}
+
+static void appendHeader(std::string &out, std::string_view name,
+                         std::string_view help, std::string_view type) {
+  out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+  out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+// Resident set size in bytes, -1 if unknown.
+static double residentBytes() {
+#ifdef __linux__
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (!file)
+    return -1;
+  long size = 0, resident = 0;
+  int n = fscanf(file, "%ld %ld", &size, &resident);
+  fclose(file);
+  if (n == 2)
+    return double(resident) * sysconf(_SC_PAGESIZE);
+#endif
+  return -1;
+}
+
+void Registry::expose(std::string &out) const {
+  std::vector<std::function<void(std::string &)>> collected;
+  {
+    std::lock_guard lock(mutex);
+    for (const auto &[name, family] : families) {
+      appendHeader(out, name, family.help, family.type);
+      for (const auto &[labels, counter] : family.counters)
+        appendSample(out, name, labels, counter->value());
+      for (const auto &[labels, gauge] : family.gauges)
+        appendSample(out, name, labels, gauge->value());
+      for (const auto &[labels, histogram] : family.histograms)
+        histogram->expose(out, name, labels);
+    }
+    for (const auto &[id, collector] : collectors)
+      collected.push_back(collector);
+  }
+  // Unlocked, collectors may register metrics
+  for (const auto &collector : collected)
+    collector(out);
+  appendHeader(out, "monitor_allocations_total",
+               "Calls of operator new, divide by monitor_ticks_total for "
+               "allocations per tick",
+               "counter");
+  appendSample(out, "monitor_allocations_total", {}, allocations());
+  double rss = residentBytes();
+  if (rss >= 0) {
+    appendHeader(out, "process_resident_memory_bytes",
+                 "Resident memory size in bytes", "gauge");
+    appendSample(out, "process_resident_memory_bytes", {}, rss);
+  }
+}
+
+void appendSample(std::string &out, std::string_view name,
+                  std::string_view labels, double value) {
+  out.append(name);
+  if (!labels.empty())
+    out.append("{").append(labels).append("}");
+  out += ' ';
+  if (std::isnan(value)) {
+    out.append("NaN");
+  } else if (std::isinf(value)) {
+    out.append(value > 0 ? "+Inf" : "-Inf");
+  } else {
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+  }
+  out += '\n';
+}
+
+void appendSample(std::string &out, std::string_view name,
+                  std::string_view labels, uint64_t value) {
+  out.append(name);
+  if (!labels.empty())
+    out.append("{").append(labels).append("}");
+  char buf[24];
+  auto result = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(" ").append(buf, result.ptr).append("\n");
+}
+
+} // namespace metrics
@@ -0,0 +1,146 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Counters, gauges and histograms exported in the Prometheus text format.
+// Hot paths keep a reference to their metric, registered once, and update
+// it with a relaxed atomic on a per-thread shard, so threads never share a
+// cache line. Shards are summed only when the metrics are exposed.
+
+namespace metrics {
+
+constexpr size_t kShards = 16;
+size_t assignShard();
+// Shard of the calling thread, assigned round robin on first use.
+inline size_t shardIndex() {
+  thread_local size_t index = kShards;
+  if (index == kShards) [[unlikely]]
+    index = assignShard();
+  return index;
+}
+
+class Counter {
+public:
+  constexpr Counter() = default;
+  void inc(uint64_t n = 1) {
+    shards[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+  uint64_t value() const;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+  std::array<Shard, kShards> shards{};
+};
+
+// Set by one owner, e.g. the event loop.
+class Gauge {
+public:
+  void set(double v) { value_.store(v, std::memory_order_relaxed); }
+  double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<double> value_{0};
+};
+
+class Histogram {
+public:
+  static constexpr size_t kMaxBuckets = 15;
+  // Upper bounds of the buckets, ascending, at most kMaxBuckets.
+  explicit Histogram(std::initializer_list<double> bounds);
+  void observe(double v);
+  // Append the samples of name with labels, e.g. `code="sh600000"`.
+  void expose(std::string &out, std::string_view name,
+              std::string_view labels) const;
+
+private:
+  struct alignas(64) Shard {
+    std::array<std::atomic<uint64_t>, kMaxBuckets + 1> counts{}; // +Inf last
+    std::atomic<double> sum{0};
+  };
+  std::vector<double> bounds;
+  std::array<Shard, kShards> shards;
+};
+
+// Metric families by name. Registering the same name and labels again
+// returns the same metric.
+class Registry {
+public:
+  static Registry &instance();
+
+  // labels are rendered, e.g. `provider="sina"`, or empty.
+  Counter &counter(std::string_view name, std::string_view help,
+                   std::string_view labels = {});
+  Gauge &gauge(std::string_view name, std::string_view help,
+               std::string_view labels = {});
+  Histogram &histogram(std::string_view name, std::string_view help,
+                       std::initializer_list<double> bounds,
+                       std::string_view labels = {});
+
+  // Collectors append whole families computed at scrape time, called on
+  // the thread of expose(). Return an id for removeCollector().
+  int addCollector(std::function<void(std::string &)> collector);
+  void removeCollector(int id);
+
+  // Append every family, the collected ones, allocations and RSS.
+  void expose(std::string &out) const;
+
+private:
+  Registry() = default;
+
+  struct Family {
+    std::string help;
+    const char *type;
+    // Labels -> metric, one of the three
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+  };
+  mutable std::mutex mutex;
+  std::map<std::string, Family, std::less<>> families;
+  std::map<int, std::function<void(std::string &)>> collectors;
+  int nextCollector = 0;
+
+  Family &family(std::string_view name, std::string_view help,
+                 const char *type);
+};
+
+inline Counter &counter(std::string_view name, std::string_view help,
+                        std::string_view labels = {}) {
+  return Registry::instance().counter(name, help, labels);
+}
+inline Gauge &gauge(std::string_view name, std::string_view help,
+                    std::string_view labels = {}) {
+  return Registry::instance().gauge(name, help, labels);
+}
+inline Histogram &histogram(std::string_view name, std::string_view help,
+                            std::initializer_list<double> bounds,
+                            std::string_view labels = {}) {
+  return Registry::instance().histogram(name, help, bounds, labels);
+}
+
+// Calls of operator new so far, counted by metrics_alloc.cpp.
+uint64_t allocations();
+
+// Append one sample line, value formatted like Prometheus expects.
+void appendSample(std::string &out, std::string_view name,
+                  std::string_view labels, double value);
+void appendSample(std::string &out, std::string_view name,
+                  std::string_view labels, uint64_t value);
+
+} // namespace metrics
+
+#endif // METRICS_H
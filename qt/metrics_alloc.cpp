@@ -0,0 +1,35 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "metrics.h"
+
+// Alone in this file, so the compiler never pairs the malloc below with a
+// delete inlined elsewhere.
+
+namespace {
+
+// Constant initialized, so allocations before main are counted too
+metrics::Counter allocationCount;
+
+} // namespace
+
+// Count every allocation, for allocations per tick. The rest is the default
+// behaviour of operator new; new[] and nothrow new call this one.
+void *operator new(std::size_t size) {
+  allocationCount.inc();
+  for (;;) {
+    if (void *p = std::malloc(size ? size : 1))
+      return p;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+uint64_t metrics::allocations() { return allocationCount.value(); }
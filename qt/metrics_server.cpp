@@ -0,0 +1,87 @@
+#include <memory>
+#include <string>
+
+#include "logger.h"
+#include "metrics.h"
+#include "metrics_server.h"
+#include "utils.h"
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QObject>
+#include <QTcpSocket>
+
+MetricsServer::MetricsServer() {
+  QObject::connect(&server, &QTcpServer::newConnection,
+                   [this]() { onConnection(); });
+}
+
+bool MetricsServer::listen(uint16_t port) {
+  if (!server.listen(QHostAddress::LocalHost, port)) {
+    LOG(ERROR) << "Metrics server listen on port " << port
+               << " failed: " << server.errorString().toStdString();
+    return false;
+  }
+  LOG(INFO) << "Metrics on http://localhost:" << port << "/metrics";
+  return true;
+}
+
+void MetricsServer::onConnection() {
+  while (QTcpSocket *socket = server.nextPendingConnection()) {
+    QObject::connect(socket, &QTcpSocket::disconnected, socket,
+                     &QObject::deleteLater);
+    auto request = std::make_shared<std::string>();
+    QObject::connect(socket, &QTcpSocket::readyRead, socket,
+                     [this, socket, request]() {
+                       QByteArray data = socket->readAll();
+                       request->append(data.data(), data.size());
+                       if (request->find("\r\n\r\n") == std::string::npos) {
+                         if (int64_t(request->size()) > maxRequest)
+                           socket->abort();
+                         return;
+                       }
+                       if (request->starts_with("GET /metrics ")) {
+                         std::string body;
+                         metrics::Registry::instance().expose(body);
+                         respond(socket, "200 OK",
+                                 "text/plain; version=0.0.4; charset=utf-8",
+                                 body);
+                       } else {
+                         respond(socket, "404 Not Found", "text/plain",
+                                 "Not found, try /metrics\n");
+                       }
+                     });
+  }
+}
+
+void MetricsServer::respond(QTcpSocket *socket, const char *status,
+                            const char *type, const std::string &body) {
+  std::string head = std::string("HTTP/1.1 ") + status +
+                     "\r\nContent-Type: " + type +
+                     "\r\nContent-Length: " + std::to_string(body.size()) +
+                     "\r\nConnection: close\r\n\r\n";
+  socket->write(head.data(), head.size());
+  socket->write(body.data(), body.size());
+  // Closes once the response is written
+  socket->disconnectFromHost();
+}
+
+void startMetricsServer() {
+  static std::unique_ptr<MetricsServer> server;
+  int port;
+  try {
+    port = getenv<int>("MONITOR_METRICS");
+  } catch (const std::unset_env &e) {
+    return;
+  } catch (const std::exception &e) {
+    LOG(ERROR) << "MONITOR_METRICS must be a port: " << e.what();
+    return;
+  }
+  if (port <= 0 || port > 65535) {
+    LOG(ERROR) << "MONITOR_METRICS must be a port, got " << port;
+    return;
+  }
+  server = std::make_unique<MetricsServer>();
+  if (!server->listen(port))
+    server.reset();
+}
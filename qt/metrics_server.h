@@ -0,0 +1,35 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <cstdint>
+
+#include <QTcpServer>
+
+class QTcpSocket;
+
+// Serves the metrics registry as Prometheus text on GET /metrics, bound to
+// localhost only. Each scrape is one short connection on the event loop.
+class MetricsServer {
+public:
+  MetricsServer();
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+  bool listen(uint16_t port);
+
+private:
+  // Longest request head accepted, scrapers send far less
+  static constexpr int64_t maxRequest = 8192;
+
+  QTcpServer server;
+
+  void onConnection();
+  void respond(QTcpSocket *socket, const char *status, const char *type,
+               const std::string &body);
+};
+
+// Start the server on the port of MONITOR_METRICS if it is set, for the
+// lifetime of the process.
+void startMetricsServer();
+
+#endif // METRICS_SERVER_H
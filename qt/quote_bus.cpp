@@ -0,0 +1,233 @@
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "quote_bus.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define QUOTE_BUS_POSIX
+#endif
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "Shared atomics must be lock free");
+
+// Offsets of the slots and the ring in a bus of capacity slots
+static size_t slotsOffset() {
+  return (sizeof(QuoteBusHeader) + 63) / 64 * 64;
+}
+static size_t ringOffset(uint32_t capacity) {
+  return slotsOffset() + sizeof(QuoteBusSlot) * capacity;
+}
+static size_t busSize(uint32_t capacity, uint32_t ringSize) {
+  return ringOffset(capacity) + sizeof(std::atomic<uint64_t>) * ringSize;
+}
+
+// Event of ring position i: the low 32 bits of i tag the slot, so a reader
+// notices an event overwritten by a later lap
+static uint64_t makeEvent(uint64_t i, uint32_t slot) {
+  return (i << 32) | slot;
+}
+
+static std::runtime_error busError(const std::string &what,
+                                   const std::string &name) {
+  return std::runtime_error(what + " quote bus " + name + ": " +
+                            strerror(errno));
+}
+
+#ifdef QUOTE_BUS_POSIX
+// POSIX shared memory names start with a single slash
+static std::string shmName(const std::string &name) {
+  return name.starts_with('/') ? name : "/" + name;
+}
+#endif
+
+QuoteBusWriter::QuoteBusWriter(const std::string &name, uint32_t capacity,
+                               uint32_t ringSize)
+    : name(name), mappedSize(busSize(capacity, ringSize)) {
+  if (ringSize == 0 || (ringSize & (ringSize - 1)) != 0)
+    throw std::invalid_argument("Ring size of the quote bus must be a power "
+                                "of two");
+#ifdef QUOTE_BUS_POSIX
+  // A new object, readers of the old one see it closed
+  shm_unlink(shmName(name).c_str());
+  int fd = shm_open(shmName(name).c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0)
+    throw busError("Create", name);
+  if (ftruncate(fd, mappedSize) != 0) {
+    close(fd);
+    throw busError("Resize", name);
+  }
+  void *addr =
+      mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    throw busError("Map", name);
+#else
+  throw std::runtime_error("Quote bus needs POSIX shared memory");
+  void *addr = nullptr;
+#endif
+  char *base = static_cast<char *>(addr);
+  // A new object is zero filled, so only the non-zero state is set
+  header = new (base) QuoteBusHeader;
+  header->capacity = capacity;
+  header->ringSize = ringSize;
+  table = reinterpret_cast<QuoteBusSlot *>(base + slotsOffset());
+  for (uint32_t i = 0; i < capacity; i++)
+    new (&table[i]) QuoteBusSlot;
+  ring = reinterpret_cast<std::atomic<uint64_t> *>(base + ringOffset(capacity));
+  for (uint32_t i = 0; i < ringSize; i++)
+    new (&ring[i]) std::atomic<uint64_t>(0);
+  header->magic.store(QuoteBusHeader::kMagic, std::memory_order_release);
+}
+
+QuoteBusWriter::~QuoteBusWriter() {
+  header->closed.store(1, std::memory_order_release);
+  notify();
+#ifdef QUOTE_BUS_POSIX
+  munmap(header, mappedSize);
+  shm_unlink(shmName(name).c_str());
+#endif
+}
+
+uint32_t QuoteBusWriter::slot(std::string_view code) {
+  auto it = slotOf.find(std::string(code));
+  if (it != slotOf.end())
+    return it->second;
+  uint32_t n = header->used.load(std::memory_order_relaxed);
+  if (n == header->capacity || code.size() >= sizeof(table[n].code))
+    return UINT32_MAX;
+  memcpy(table[n].code, code.data(), code.size());
+  table[n].code[code.size()] = '\0';
+  // Publishes the code together with the count
+  header->used.store(n + 1, std::memory_order_release);
+  slotOf.emplace(std::string(code), n);
+  return n;
+}
+
+void QuoteBusWriter::publish(uint32_t slot, const BusQuote &quote) {
+  table[slot].quote.store(quote);
+  uint64_t i = header->head.load(std::memory_order_relaxed);
+  ring[i & (header->ringSize - 1)].store(makeEvent(i, slot),
+                                         std::memory_order_release);
+  header->head.store(i + 1, std::memory_order_release);
+}
+
+void QuoteBusWriter::notify() {
+  header->wakeups.fetch_add(1, std::memory_order_release);
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&header->wakeups),
+          FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+QuoteBusReader::QuoteBusReader(const std::string &name) {
+#ifdef QUOTE_BUS_POSIX
+  int fd = shm_open(shmName(name).c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    throw busError("Open", name);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(QuoteBusHeader)) {
+    close(fd);
+    throw std::runtime_error("Quote bus " + name + " is not ready");
+  }
+  mappedSize = st.st_size;
+  void *addr = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    throw busError("Map", name);
+#else
+  throw std::runtime_error("Quote bus needs POSIX shared memory");
+  void *addr = nullptr;
+#endif
+  const char *base = static_cast<const char *>(addr);
+  header = reinterpret_cast<const QuoteBusHeader *>(base);
+  if (header->magic.load(std::memory_order_acquire) != QuoteBusHeader::kMagic ||
+      mappedSize < busSize(header->capacity, header->ringSize)) {
+#ifdef QUOTE_BUS_POSIX
+    munmap(addr, mappedSize);
+#endif
+    throw std::runtime_error("Quote bus " + name + " is not ready");
+  }
+  table = reinterpret_cast<const QuoteBusSlot *>(base + slotsOffset());
+  ring = reinterpret_cast<const std::atomic<uint64_t> *>(
+      base + ringOffset(header->capacity));
+  // Changes before opening are in the slots already
+  cursor = header->head.load(std::memory_order_acquire);
+}
+
+QuoteBusReader::~QuoteBusReader() {
+#ifdef QUOTE_BUS_POSIX
+  munmap(const_cast<QuoteBusHeader *>(header), mappedSize);
+#endif
+}
+
+uint32_t QuoteBusReader::find(std::string_view code) const {
+  uint32_t n = size();
+  for (uint32_t i = 0; i < n; i++) {
+    if (code == table[i].code)
+      return i;
+  }
+  return UINT32_MAX;
+}
+
+bool QuoteBusReader::poll(std::vector<uint32_t> &changed) {
+  uint64_t head = header->head.load(std::memory_order_acquire);
+  if (head == cursor)
+    return false;
+  const uint64_t ringSize = header->ringSize;
+  bool lapped = head - cursor > ringSize;
+  size_t first = changed.size();
+  for (uint64_t i = cursor; i < head && !lapped; i++) {
+    uint64_t event = ring[i & (ringSize - 1)].load(std::memory_order_acquire);
+    lapped = (event >> 32) != (i & UINT32_MAX);
+    changed.push_back(uint32_t(event));
+  }
+  if (lapped) {
+    // Lost track of the events, every slot may have changed
+    changed.resize(first);
+    for (uint32_t slot = 0; slot < size(); slot++)
+      changed.push_back(slot);
+  }
+  cursor = head;
+  return true;
+}
+
+void QuoteBusReader::wait(int timeoutMs) {
+  constexpr int spins = 100;
+  // Load the futex word before checking, a batch published after the check
+  // bumps it and the futex returns at once
+  uint32_t wakeups = header->wakeups.load(std::memory_order_acquire);
+  for (int i = 0; i < spins; i++) {
+    if (header->head.load(std::memory_order_acquire) != cursor || closed())
+      return;
+    SEQLOCK_PAUSE();
+  }
+#if defined(__linux__)
+  timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+  syscall(SYS_futex,
+          reinterpret_cast<uint32_t *>(
+              const_cast<std::atomic<uint32_t> *>(&header->wakeups)),
+          FUTEX_WAIT, wakeups, &timeout, nullptr, 0);
+#else
+  (void)wakeups;
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+  while (header->head.load(std::memory_order_acquire) == cursor &&
+         !closed() && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+}
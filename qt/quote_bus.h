@@ -0,0 +1,115 @@
+#ifndef QUOTE_BUS_H
+#define QUOTE_BUS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "seqlock.h"
+
+// Shared-memory quote bus. The daemon writes the latest quote of every code
+// into a fixed-size slot of a POSIX shared memory object, and appends the
+// slot to a ring of change events. Any local process maps it read-only and
+// reads quotes straight from the slots, without syscalls or copies beyond
+// the seqlock read, polling the ring or sleeping on a futex until the next
+// batch. Needs no Qt, readers link only QuoteBus.
+
+// Quote of a slot, plain numbers so any process can read it.
+struct BusQuote {
+  double curPrice;
+  double basePrice; // Close of the previous day
+  double openPrice;
+  double volume;   // Accumulated volume of the day
+  double turnover; // Accumulated turnover of the day
+  int64_t time;    // Milliseconds since epoch of the fetch
+  char name[32];   // UTF-8, NUL terminated
+};
+
+// Layout of the shared memory: this header, then the slots, then the ring.
+struct QuoteBusHeader {
+  static constexpr uint64_t kMagic = 0x5155425553303031; // "QUBUS001"
+
+  std::atomic<uint64_t> magic; // Stored last, once the layout is ready
+  uint32_t capacity;           // Slots
+  uint32_t ringSize;           // Events, a power of two
+  alignas(64) std::atomic<uint32_t> used; // Slots with final codes
+  std::atomic<uint32_t> closed;           // The writer is gone
+  alignas(64) std::atomic<uint64_t> head; // Events appended so far
+  std::atomic<uint32_t> wakeups;          // Futex word, bumped per batch
+};
+
+struct alignas(64) QuoteBusSlot {
+  char code[16];
+  SeqLock<BusQuote> quote;
+};
+
+// The single writer, owned by the daemon.
+class QuoteBusWriter {
+public:
+  // Create the bus name, replacing a stale one, throw std::runtime_error on
+  // failure.
+  QuoteBusWriter(const std::string &name, uint32_t capacity = 4096,
+                 uint32_t ringSize = 65536);
+  // Marks the bus closed and removes the name, mapped readers keep reading.
+  ~QuoteBusWriter();
+  QuoteBusWriter(const QuoteBusWriter &) = delete;
+  QuoteBusWriter &operator=(const QuoteBusWriter &) = delete;
+
+  // Slot of code, allocated on first use. Return UINT32_MAX once full.
+  uint32_t slot(std::string_view code);
+  // Store the quote of a slot and append a change event.
+  void publish(uint32_t slot, const BusQuote &quote);
+  // Wake readers waiting for changes, once per batch of publish().
+  void notify();
+
+private:
+  std::string name;
+  size_t mappedSize;
+  QuoteBusHeader *header;
+  QuoteBusSlot *table; // The slots
+  std::atomic<uint64_t> *ring;
+  std::unordered_map<std::string, uint32_t> slotOf;
+};
+
+// A read-only mapping of the bus, used from one thread.
+class QuoteBusReader {
+public:
+  // Map the bus name, throw std::runtime_error if it does not exist.
+  explicit QuoteBusReader(const std::string &name);
+  ~QuoteBusReader();
+  QuoteBusReader(const QuoteBusReader &) = delete;
+  QuoteBusReader &operator=(const QuoteBusReader &) = delete;
+
+  uint32_t size() const {
+    return header->used.load(std::memory_order_acquire);
+  }
+  std::string_view code(uint32_t slot) const { return table[slot].code; }
+  // Return UINT32_MAX if code has no slot.
+  uint32_t find(std::string_view code) const;
+  BusQuote quote(uint32_t slot) const { return table[slot].quote.load(); }
+  // The writer exited, reopen the bus once a new one is up.
+  bool closed() const {
+    return header->closed.load(std::memory_order_acquire) != 0;
+  }
+
+  // Append the slots changed since the last poll to changed, all of them if
+  // the ring wrapped past this reader. Return false if nothing changed.
+  bool poll(std::vector<uint32_t> &changed);
+  // Block until a batch is published after the last poll, the bus closes or
+  // timeoutMs passes. Spins a little, then sleeps on a futex on Linux and
+  // polls elsewhere.
+  void wait(int timeoutMs);
+
+private:
+  size_t mappedSize;
+  const QuoteBusHeader *header;
+  const QuoteBusSlot *table; // The slots
+  const std::atomic<uint64_t> *ring;
+  uint64_t cursor = 0; // Next event to read
+};
+
+#endif // QUOTE_BUS_H
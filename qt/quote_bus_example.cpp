@@ -0,0 +1,38 @@
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "quote_bus.h"
+
+// Print every quote change on the bus of the daemon, e.g.
+//   QuoteBusExample [name]
+int main(int argc, char *argv[]) {
+  std::string name = argc == 2 ? argv[1] : "stock-monitor";
+  try {
+    QuoteBusReader bus(name);
+    std::vector<uint32_t> changed;
+    // Quotes published before opening
+    for (uint32_t slot = 0; slot < bus.size(); slot++)
+      changed.push_back(slot);
+    while (!bus.closed()) {
+      for (uint32_t slot : changed) {
+        BusQuote quote = bus.quote(slot);
+        double pct = quote.basePrice == 0
+                         ? 0
+                         : (quote.curPrice / quote.basePrice - 1) * 100;
+        printf("%-10s %-12s %10.3f %+7.2f%%\n",
+               std::string(bus.code(slot)).c_str(), quote.name,
+               quote.curPrice, pct);
+      }
+      fflush(stdout);
+      changed.clear();
+      bus.wait(1000);
+      bus.poll(changed);
+    }
+  } catch (const std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
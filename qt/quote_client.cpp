@@ -0,0 +1,204 @@
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "logger.h"
+#include "quote_client.h"
+#include "utils.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+bool useQuoteDaemon() {
+  static const bool enabled = [] {
+    try {
+      getenv<std::string_view>("MONITOR_DAEMON");
+      return true;
+    } catch (const std::unset_env &e) {
+      return false;
+    }
+  }();
+  return enabled;
+}
+
+QuoteClient &QuoteClient::instance() {
+  static QuoteClient client;
+  return client;
+}
+
+QuoteClient::QuoteClient() : serverName(defaultQuoteServer) {
+  auto name = getenv<std::string>("MONITOR_DAEMON");
+  if (!name.empty())
+    serverName = name;
+  reconnectTimer.setSingleShot(true);
+  QObject::connect(&reconnectTimer, &QTimer::timeout, [this]() {
+    socket.connectToServer(QString::fromStdString(serverName));
+  });
+  QObject::connect(&socket, &QLocalSocket::connected,
+                   [this]() { onConnected(); });
+  QObject::connect(&socket, &QLocalSocket::disconnected,
+                   [this]() { onDisconnected(); });
+  QObject::connect(&socket, &QLocalSocket::errorOccurred,
+                   [this](QLocalSocket::LocalSocketError) {
+                     if (socket.state() == QLocalSocket::UnconnectedState)
+                       onDisconnected();
+                   });
+  QObject::connect(&socket, &QLocalSocket::readyRead,
+                   [this]() { onReadyRead(); });
+  socket.connectToServer(QString::fromStdString(serverName));
+}
+
+void QuoteClient::subscribe(SymbolId id) {
+  if (id >= quotes.size())
+    quotes.resize(SymbolTable::instance().size());
+  if (quotes[id].refs++ == 0)
+    send(QuoteFrameType::kSubscribe, id);
+}
+
+void QuoteClient::unsubscribe(SymbolId id) {
+  if (id >= quotes.size() || quotes[id].refs == 0)
+    return;
+  if (--quotes[id].refs > 0)
+    return;
+  send(QuoteFrameType::kUnsubscribe, id);
+  // The fetcher is gone, so is whoever waits
+  quotes[id] = Quote();
+}
+
+void QuoteClient::take(SymbolId id, FetchCallback &&callback) {
+  Quote &quote = quotes[id];
+  if (quote.fresh) {
+    quote.fresh = false;
+    callback(quote.info);
+  } else if (!quote.received &&
+             socket.state() != QLocalSocket::UnconnectedState) {
+    quote.waiting = std::move(callback);
+  } else {
+    callback(std::nullopt);
+  }
+}
+
+// Hand a new quote of id to a waiting fetch.
+void QuoteClient::answer(SymbolId id) {
+  Quote &quote = quotes[id];
+  if (!quote.waiting)
+    return;
+  FetchCallback callback = std::move(quote.waiting);
+  quote.waiting = nullptr;
+  quote.fresh = false;
+  callback(quote.info);
+}
+
+void QuoteClient::send(QuoteFrameType type, SymbolId id) {
+  if (socket.state() != QLocalSocket::ConnectedState)
+    return;
+  out.clear();
+  encodeCodeFrame(out, type, symbolCode(id));
+  socket.write(out.data(), out.size());
+}
+
+void QuoteClient::onConnected() {
+  LOG(INFO) << "Connected to quote daemon " << serverName;
+  online = true;
+  for (SymbolId id = 0; id < quotes.size(); id++) {
+    if (quotes[id].refs > 0)
+      send(QuoteFrameType::kSubscribe, id);
+  }
+}
+
+void QuoteClient::onDisconnected() {
+  if (reconnectTimer.isActive())
+    return;
+  if (online)
+    LOG(WARNING) << "Lost quote daemon " << serverName << ", reconnecting";
+  online = false;
+  channels.clear();
+  reader = QuoteFrameReader();
+  // Pending stocks stop waiting, and fetch again on the next cycle
+  for (auto &quote : quotes) {
+    if (quote.waiting) {
+      FetchCallback callback = std::move(quote.waiting);
+      quote.waiting = nullptr;
+      callback(std::nullopt);
+    }
+  }
+  reconnectTimer.start(reconnectInterval);
+}
+
+void QuoteClient::onReadyRead() {
+  QByteArray data = socket.readAll();
+  reader.append(data.data(), data.size());
+  while (auto frame = reader.next()) {
+    switch (frame->type) {
+    case QuoteFrameType::kSnapshot: {
+      StockInfo info;
+      int64_t time;
+      auto decoded = decodeSnapshot(frame->payload, info, time);
+      if (!decoded)
+        break;
+      SymbolId id = SymbolTable::instance().lookup(decoded->second);
+      if (id >= quotes.size() || quotes[id].refs == 0)
+        break;
+      channels[decoded->first] = id;
+      Quote &quote = quotes[id];
+      quote.info = std::move(info);
+      quote.time = time;
+      quote.fresh = quote.received = true;
+      answer(id);
+      break;
+    }
+    case QuoteFrameType::kDelta: {
+      auto channel = deltaChannel(frame->payload);
+      auto it = channel ? channels.find(*channel) : channels.end();
+      if (it == channels.end() || quotes[it->second].refs == 0)
+        break;
+      Quote &quote = quotes[it->second];
+      if (!applyDelta(frame->payload, quote.info, quote.time))
+        break;
+      quote.fresh = true;
+      answer(it->second);
+      break;
+    }
+    case QuoteFrameType::kReject: {
+      LOG(ERROR) << "Quote daemon cannot fetch " << frame->payload;
+      SymbolId id = SymbolTable::instance().lookup(frame->payload);
+      if (id < quotes.size() && quotes[id].waiting) {
+        FetchCallback callback = std::move(quotes[id].waiting);
+        quotes[id].waiting = nullptr;
+        callback(std::nullopt);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  if (reader.failed()) {
+    LOG(ERROR) << "Malformed frame from quote daemon " << serverName
+               << ", reconnecting";
+    QTimer::singleShot(0, &socket, [this]() { socket.abort(); });
+  }
+}
+
+// Takes quotes from the daemon instead of fetching them.
+class DaemonFetcher : public StockFetcher {
+public:
+  explicit DaemonFetcher(SymbolId id) : StockFetcher(id) {
+    QuoteClient::instance().subscribe(id);
+  }
+  ~DaemonFetcher() override { QuoteClient::instance().unsubscribe(id); }
+
+  StockInfo fetchData() override {
+    throw std::runtime_error("Quotes of the daemon are only pushed");
+  }
+  void fetchDataAsync(FetchCallback &&callback) override {
+    QuoteClient::instance().take(id, std::move(callback));
+  }
+
+  static bool regist;
+};
+
+bool DaemonFetcher::regist = StockFetcher::registCreator(
+    StockFetcher::Type::kDaemon,
+    [](SymbolId id) -> StockFetcher * { return new DaemonFetcher(id); });
@@ -0,0 +1,64 @@
+#ifndef QUOTE_CLIENT_H
+#define QUOTE_CLIENT_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "quote_protocol.h"
+#include "stock_fetcher.h"
+#include "symbol_table.h"
+
+#include <QLocalSocket>
+#include <QTimer>
+
+// True if MONITOR_DAEMON is set, stocks then take their quotes from the
+// daemon listening on the socket it names, or on the default one if empty.
+bool useQuoteDaemon();
+
+// Connection of a thin client to the quote daemon, used from the owner
+// thread. Fetchers subscribe their codes and take the latest quote pushed by
+// the daemon. Subscriptions are sent again after a reconnect.
+class QuoteClient {
+public:
+  static QuoteClient &instance();
+
+  void subscribe(SymbolId id);
+  void unsubscribe(SymbolId id);
+  // Call back with the latest quote of id if it changed since the last call.
+  // Before the first quote of id the call back waits for it, unless the
+  // daemon is unreachable or rejects the code.
+  void take(SymbolId id, FetchCallback &&callback);
+
+private:
+  QuoteClient();
+
+  struct Quote {
+    int refs = 0;
+    bool fresh = false;
+    bool received = false;
+    int64_t time = 0;
+    StockInfo info{};
+    FetchCallback waiting; // take() before the first quote
+  };
+  static constexpr int reconnectInterval = 1000; // ms
+
+  std::string serverName;
+  bool online = false; // Connected, to log only changes
+  QLocalSocket socket;
+  QTimer reconnectTimer;
+  QuoteFrameReader reader;
+  std::string out; // Reused output
+  std::vector<Quote> quotes; // Indexed by symbol id
+  std::unordered_map<uint32_t, SymbolId> channels; // Daemon channel -> id
+
+  void send(QuoteFrameType type, SymbolId id);
+  void onConnected();
+  void onDisconnected();
+  void onReadyRead();
+  void answer(SymbolId id);
+};
+
+#endif // QUOTE_CLIENT_H
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <utility>
+
+#include "logger.h"
+#include "market_clock.h"
+#include "quote_daemon.h"
+#include "stock.h"
+#include "stock_fetcher.h"
+#include "utils.h"
+
+#include <QByteArray>
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+
+QuoteDaemon::QuoteDaemon(int64_t freq) {
+  NetworkFetcher::setFreq(freq);
+  QObject::connect(&server, &QLocalServer::newConnection,
+                   [this]() { onConnection(); });
+  QObject::connect(&fetchTimer, &QTimer::timeout, [this]() {
+    for (SymbolId id = 0; id < channels.size(); id++) {
+      if (!channels[id].subscribers.empty() || channels[id].pinned)
+        fetch(id);
+    }
+  });
+  MarketClock::instance().start(fetchTimer, freq);
+}
+
+QuoteDaemon::~QuoteDaemon() {
+  // Sockets are owned by the server, keep their last signals away from us
+  for (auto &client : clients)
+    QObject::disconnect(client->socket, nullptr, nullptr, nullptr);
+}
+
+bool QuoteDaemon::listen(const std::string &serverName) {
+  QString name = QString::fromStdString(serverName);
+  QLocalServer::removeServer(name);
+  if (!server.listen(name)) {
+    LOG(ERROR) << "Listen on " << serverName
+               << " failed: " << server.errorString().toStdString();
+    return false;
+  }
+  LOG(INFO) << "Quote daemon listening on "
+            << server.fullServerName().toStdString();
+  return true;
+}
+
+void QuoteDaemon::publishTo(std::unique_ptr<QuoteBusWriter> bus,
+                            const std::vector<SymbolId> &codes) {
+  this->bus = std::move(bus);
+  for (SymbolId id : codes) {
+    if (id >= channels.size())
+      channels.resize(SymbolTable::instance().size());
+    Channel &channel = channels[id];
+    channel.fetcher.reset(StockFetcher::createFor(id));
+    if (!channel.fetcher) {
+      LOG(ERROR) << "No fetcher for stock_code: " << symbolCode(id);
+      continue;
+    }
+    channel.pinned = true;
+    fetch(id);
+  }
+}
+
+void QuoteDaemon::onConnection() {
+  while (QLocalSocket *socket = server.nextPendingConnection()) {
+    clients.push_back(std::make_unique<Client>());
+    Client *client = clients.back().get();
+    client->socket = socket;
+    QObject::connect(socket, &QLocalSocket::readyRead, socket,
+                     [this, client]() { onReadyRead(client); });
+    QObject::connect(socket, &QLocalSocket::disconnected, socket,
+                     [this, client]() { removeClient(client); });
+  }
+}
+
+void QuoteDaemon::onReadyRead(Client *client) {
+  QByteArray data = client->socket->readAll();
+  client->reader.append(data.data(), data.size());
+  while (auto frame = client->reader.next()) {
+    switch (frame->type) {
+    case QuoteFrameType::kSubscribe:
+      subscribe(client, frame->payload);
+      break;
+    case QuoteFrameType::kUnsubscribe: {
+      SymbolId id = SymbolTable::instance().lookup(frame->payload);
+      if (id != kInvalidSymbol)
+        unsubscribe(client, id);
+      break;
+    }
+    default:
+      LOG(WARNING) << "Unexpected frame from client, type "
+                   << static_cast<int>(frame->type);
+      break;
+    }
+  }
+  if (client->reader.failed()) {
+    LOG(WARNING) << "Dropping a client that sent a malformed frame";
+    QLocalSocket *socket = client->socket;
+    QTimer::singleShot(0, socket, [socket]() { socket->abort(); });
+  }
+}
+
+void QuoteDaemon::removeClient(Client *client) {
+  // Copy, unsubscribe() edits the list
+  auto subscriptions = client->subscriptions;
+  for (SymbolId id : subscriptions)
+    unsubscribe(client, id);
+  client->socket->deleteLater();
+  auto it = std::find_if(clients.begin(), clients.end(),
+                         [client](const auto &c) { return c.get() == client; });
+  if (it != clients.end())
+    clients.erase(it);
+}
+
+void QuoteDaemon::subscribe(Client *client, std::string_view code) {
+  SymbolId id = internSymbol(code);
+  if (id >= channels.size())
+    channels.resize(SymbolTable::instance().size());
+  Channel &channel = channels[id];
+  if (!channel.fetcher)
+    channel.fetcher.reset(StockFetcher::createFor(id));
+  if (!channel.fetcher) {
+    frame.clear();
+    encodeCodeFrame(frame, QuoteFrameType::kReject, code);
+    send(client, frame);
+    return;
+  }
+  auto &subscribers = channel.subscribers;
+  if (std::find(subscribers.begin(), subscribers.end(), client) !=
+      subscribers.end())
+    return;
+  subscribers.push_back(client);
+  client->subscriptions.push_back(id);
+  if (channel.last) {
+    // Deltas go on from the current quote
+    frame.clear();
+    encodeSnapshot(frame, id, code, *channel.last, channel.time);
+    send(client, frame);
+  } else {
+    fetch(id);
+  }
+}
+
+void QuoteDaemon::unsubscribe(Client *client, SymbolId id) {
+  auto &subscriptions = client->subscriptions;
+  auto it = std::find(subscriptions.begin(), subscriptions.end(), id);
+  if (it == subscriptions.end())
+    return;
+  subscriptions.erase(it);
+  Channel &channel = channels[id];
+  std::erase(channel.subscribers, client);
+  // Stop fetching, a pending reply is dropped with the fetcher
+  if (channel.subscribers.empty() && !channel.pinned)
+    channel = Channel();
+}
+
+void QuoteDaemon::fetch(SymbolId id) {
+  Channel &channel = channels[id];
+  // Codes are fetched once outside trading hours, like in the widget
+  if (channel.fetching || (channel.last && !Stock::isTradingTime()))
+    return;
+  channel.fetching = true;
+  channel.fetcher->fetchDataAsync(
+      [this, id](std::optional<StockInfo> info) { onReply(id, info); });
+}
+
+void QuoteDaemon::onReply(SymbolId id, std::optional<StockInfo> info) {
+  Channel &channel = channels[id];
+  channel.fetching = false;
+  if (!info)
+    return;
+  int64_t time = MarketClock::instance().now();
+  frame.clear();
+  // Also when the clock went back, which a delta cannot carry
+  if (!channel.last || !deltaFits(channel.time, time))
+    encodeSnapshot(frame, id, symbolCode(id), *info, time);
+  else if (!encodeDelta(frame, id, *channel.last, channel.time, *info, time))
+    return;
+  channel.last = std::move(info);
+  channel.time = time;
+  for (Client *client : channel.subscribers)
+    send(client, frame);
+  if (bus)
+    publish(id);
+}
+
+void QuoteDaemon::publish(SymbolId id) {
+  Channel &channel = channels[id];
+  if (channel.busSlot == UINT32_MAX) {
+    channel.busSlot = bus->slot(symbolCode(id));
+    if (channel.busSlot == UINT32_MAX) {
+      LOG(ERROR) << "Quote bus is full, " << symbolCode(id) << " is left out";
+      return;
+    }
+  }
+  const StockInfo &info = *channel.last;
+  BusQuote quote{.curPrice = info.curPrice,
+                 .basePrice = info.yesterdayPrice,
+                 .openPrice = info.openPrice,
+                 .volume = info.volume,
+                 .turnover = info.turnover,
+                 .time = channel.time,
+                 .name = {}};
+  copyUtf8(quote.name, sizeof(quote.name), info.name);
+  bus->publish(channel.busSlot, quote);
+  // Replies of a cycle arrive in one burst, wake readers after it
+  if (!notifyPending) {
+    notifyPending = true;
+    QTimer::singleShot(0, &fetchTimer, [this]() {
+      notifyPending = false;
+      bus->notify();
+    });
+  }
+}
+
+void QuoteDaemon::send(Client *client, const std::string &data) {
+  QLocalSocket *socket = client->socket;
+  if (socket->state() != QLocalSocket::ConnectedState)
+    return;
+  if (socket->bytesToWrite() > maxPending) {
+    // Stuck client, drop it once the current fan out is done
+    LOG(WARNING) << "Dropping a client that does not read its quotes";
+    QTimer::singleShot(0, socket, [socket]() { socket->abort(); });
+    return;
+  }
+  socket->write(data.data(), data.size());
+}
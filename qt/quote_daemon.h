@@ -0,0 +1,77 @@
+#ifndef QUOTE_DAEMON_H
+#define QUOTE_DAEMON_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "quote_bus.h"
+#include "quote_protocol.h"
+#include "stock_fetcher.h"
+#include "symbol_table.h"
+
+#include <QLocalServer>
+#include <QTimer>
+
+class QLocalSocket;
+
+// Owns the fetching of every code subscribed by local clients and fans the
+// quotes out over a local socket, so a code is fetched once however many
+// widgets, dashboards and scripts watch it. A code is fetched while it has
+// subscribers, and each fetch cycle writes one delta frame per changed code
+// to all of them.
+class QuoteDaemon {
+public:
+  explicit QuoteDaemon(int64_t freq);
+  ~QuoteDaemon();
+  QuoteDaemon(const QuoteDaemon &) = delete;
+  QuoteDaemon &operator=(const QuoteDaemon &) = delete;
+
+  // Listen on serverName, replacing a stale socket of a dead daemon.
+  bool listen(const std::string &serverName);
+  // Also write every quote to bus. Its readers cannot subscribe, so codes
+  // are fetched regardless of clients.
+  void publishTo(std::unique_ptr<QuoteBusWriter> bus,
+                 const std::vector<SymbolId> &codes);
+
+private:
+  struct Client {
+    QLocalSocket *socket;
+    QuoteFrameReader reader;
+    std::vector<SymbolId> subscriptions;
+  };
+  // Channel ids are symbol ids of the daemon
+  struct Channel {
+    std::unique_ptr<StockFetcher> fetcher;
+    std::optional<StockInfo> last; // Last quote sent to subscribers
+    int64_t time = 0;
+    bool fetching = false;
+    bool pinned = false; // Fetched for the bus without subscribers
+    uint32_t busSlot = UINT32_MAX;
+    std::vector<Client *> subscribers;
+  };
+  // Drop a client that lets this much output pile up
+  static constexpr int64_t maxPending = 1 << 20;
+
+  QLocalServer server;
+  QTimer fetchTimer;
+  std::vector<std::unique_ptr<Client>> clients;
+  std::vector<Channel> channels; // Indexed by symbol id
+  std::string frame;             // Reused output
+  std::unique_ptr<QuoteBusWriter> bus;
+  bool notifyPending = false; // Bus readers are woken once per batch
+
+  void onConnection();
+  void onReadyRead(Client *client);
+  void removeClient(Client *client);
+  void subscribe(Client *client, std::string_view code);
+  void unsubscribe(Client *client, SymbolId id);
+  void fetch(SymbolId id);
+  void onReply(SymbolId id, std::optional<StockInfo> info);
+  void send(Client *client, const std::string &data);
+  void publish(SymbolId id);
+};
+
+#endif // QUOTE_DAEMON_H
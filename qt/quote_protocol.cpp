@@ -0,0 +1,168 @@
+#include <cstring>
+#include <iterator>
+
+#include "quote_protocol.h"
+
+// Numbers in wire order, bit i of a delta mask stands for numberFields[i]
+// and the next bit for the name
+static constexpr double StockInfo::*numberFields[] = {
+    &StockInfo::curPrice, &StockInfo::yesterdayPrice, &StockInfo::openPrice,
+    &StockInfo::volume, &StockInfo::turnover};
+static constexpr uint8_t nameBit = 1 << std::size(numberFields);
+static constexpr size_t maxFrameSize = UINT16_MAX;
+
+template <typename T> static void put(std::string &out, T value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Reads fixed-size values off a payload, failing once it runs out.
+class PayloadReader {
+public:
+  explicit PayloadReader(std::string_view payload) : rest(payload) {}
+  template <typename T> bool get(T &value) {
+    if (rest.size() < sizeof(T))
+      return false;
+    memcpy(&value, rest.data(), sizeof(T));
+    rest.remove_prefix(sizeof(T));
+    return true;
+  }
+  bool get(std::string_view &value, size_t size) {
+    if (rest.size() < size)
+      return false;
+    value = rest.substr(0, size);
+    rest.remove_prefix(size);
+    return true;
+  }
+  std::string_view remaining() const { return rest; }
+
+private:
+  std::string_view rest;
+};
+
+// Reserve the length of a frame starting at out.size(), filled by endFrame.
+static size_t beginFrame(std::string &out, QuoteFrameType type) {
+  size_t start = out.size();
+  put(out, uint16_t(0));
+  put(out, type);
+  return start;
+}
+
+static void endFrame(std::string &out, size_t start) {
+  size_t size = out.size() - start - sizeof(uint16_t);
+  if (size > maxFrameSize) {
+    // Only names are unbounded, and they are short
+    out.resize(start);
+    return;
+  }
+  uint16_t length = size;
+  memcpy(out.data() + start, &length, sizeof(length));
+}
+
+void encodeCodeFrame(std::string &out, QuoteFrameType type,
+                     std::string_view code) {
+  size_t start = beginFrame(out, type);
+  out.append(code);
+  endFrame(out, start);
+}
+
+void encodeSnapshot(std::string &out, uint32_t channel, std::string_view code,
+                    const StockInfo &info, int64_t time) {
+  size_t start = beginFrame(out, QuoteFrameType::kSnapshot);
+  put(out, channel);
+  put(out, time);
+  for (auto field : numberFields)
+    put(out, info.*field);
+  code = code.substr(0, UINT8_MAX);
+  put(out, uint8_t(code.size()));
+  out.append(code);
+  out.append(info.name);
+  endFrame(out, start);
+}
+
+bool encodeDelta(std::string &out, uint32_t channel, const StockInfo &prev,
+                 int64_t prevTime, const StockInfo &info, int64_t time) {
+  uint8_t mask = 0;
+  for (size_t i = 0; i < std::size(numberFields); i++) {
+    if (info.*numberFields[i] != prev.*numberFields[i])
+      mask |= 1 << i;
+  }
+  if (info.name != prev.name)
+    mask |= nameBit;
+  if (mask == 0)
+    return false;
+
+  size_t start = beginFrame(out, QuoteFrameType::kDelta);
+  put(out, channel);
+  put(out, mask);
+  put(out, uint32_t(time - prevTime));
+  for (size_t i = 0; i < std::size(numberFields); i++) {
+    if (mask & (1 << i))
+      put(out, info.*numberFields[i]);
+  }
+  if (mask & nameBit)
+    out.append(info.name);
+  endFrame(out, start);
+  return true;
+}
+
+std::optional<QuoteFrame> QuoteFrameReader::next() {
+  // Drop consumed frames once they are most of the buffer
+  if (consumed > 4096 && consumed * 2 > buffer.size()) {
+    buffer.erase(0, consumed);
+    consumed = 0;
+  }
+  uint16_t length;
+  if (buffer.size() - consumed < sizeof(length))
+    return std::nullopt;
+  memcpy(&length, buffer.data() + consumed, sizeof(length));
+  // Every frame has a type byte, without it the stream would stall here
+  if (length == 0)
+    error = true;
+  if (error || buffer.size() - consumed - sizeof(length) < length)
+    return std::nullopt;
+  std::string_view frame(buffer.data() + consumed + sizeof(length), length);
+  consumed += sizeof(length) + length;
+  return QuoteFrame{static_cast<QuoteFrameType>(frame[0]), frame.substr(1)};
+}
+
+std::optional<std::pair<uint32_t, std::string_view>>
+decodeSnapshot(std::string_view payload, StockInfo &info, int64_t &time) {
+  PayloadReader reader(payload);
+  uint32_t channel;
+  uint8_t codeSize;
+  std::string_view code;
+  if (!reader.get(channel) || !reader.get(time))
+    return std::nullopt;
+  for (auto field : numberFields) {
+    if (!reader.get(info.*field))
+      return std::nullopt;
+  }
+  if (!reader.get(codeSize) || !reader.get(code, codeSize))
+    return std::nullopt;
+  info.name = reader.remaining();
+  return std::pair(channel, code);
+}
+
+std::optional<uint32_t> deltaChannel(std::string_view payload) {
+  uint32_t channel;
+  if (!PayloadReader(payload).get(channel))
+    return std::nullopt;
+  return channel;
+}
+
+bool applyDelta(std::string_view payload, StockInfo &info, int64_t &time) {
+  PayloadReader reader(payload);
+  uint32_t channel;
+  uint8_t mask;
+  uint32_t step;
+  if (!reader.get(channel) || !reader.get(mask) || !reader.get(step))
+    return false;
+  for (size_t i = 0; i < std::size(numberFields); i++) {
+    if ((mask & (1 << i)) && !reader.get(info.*numberFields[i]))
+      return false;
+  }
+  if (mask & nameBit)
+    info.name = reader.remaining();
+  time += step;
+  return true;
+}
@@ -0,0 +1,88 @@
+#ifndef QUOTE_PROTOCOL_H
+#define QUOTE_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "stock_fetcher.h"
+
+// Wire format between the quote daemon and its local clients, in the byte
+// order of the host. Every frame is a uint16 length, then that many bytes: a
+// type byte and the payload.
+//
+//   kSubscribe, kUnsubscribe  client -> daemon, payload is the code
+//   kReject                   daemon -> client, the code cannot be fetched
+//   kSnapshot                 daemon -> client, every field of a code:
+//                             channel u32, time i64, curPrice, yesterdayPrice,
+//                             openPrice, volume, turnover (f64), code length
+//                             u8, code, name
+//   kDelta                    daemon -> client, fields changed since the last
+//                             frame of the channel: channel u32, mask u8,
+//                             time step u32 in ms, the f64 of each set bit in
+//                             field order, then the name if its bit is set
+//
+// A channel identifies a code for the life of the daemon. Every subscriber of
+// a channel has seen the same last frame, so a delta is encoded once and
+// written to all of them.
+enum class QuoteFrameType : uint8_t {
+  kSubscribe = 1,
+  kUnsubscribe = 2,
+  kReject = 3,
+  kSnapshot = 4,
+  kDelta = 5,
+};
+
+// Socket name of the daemon unless MONITOR_DAEMON names another
+constexpr const char *defaultQuoteServer = "stock-monitor";
+
+struct QuoteFrame {
+  QuoteFrameType type;
+  std::string_view payload; // Points into the reader buffer
+};
+
+// Splits a byte stream into frames.
+class QuoteFrameReader {
+public:
+  void append(const char *data, size_t size) { buffer.append(data, size); }
+  // Next complete frame, valid until the next call of append or next.
+  std::optional<QuoteFrame> next();
+  // A malformed frame was read, the stream cannot be split any further and
+  // the connection should be dropped.
+  bool failed() const { return error; }
+
+private:
+  std::string buffer;
+  size_t consumed = 0;
+  bool error = false;
+};
+
+// Append a frame with a code payload.
+void encodeCodeFrame(std::string &out, QuoteFrameType type,
+                     std::string_view code);
+void encodeSnapshot(std::string &out, uint32_t channel, std::string_view code,
+                    const StockInfo &info, int64_t time);
+// Whether time can follow prevTime in a delta, whose step is an unsigned
+// 32-bit count of ms. Otherwise, e.g. when a clock went back, send a
+// snapshot.
+inline bool deltaFits(int64_t prevTime, int64_t time) {
+  return time >= prevTime && time - prevTime <= int64_t(UINT32_MAX);
+}
+// Append the delta from prev at prevTime to info at time, return false and
+// append nothing if no field changed. The times must pass deltaFits().
+bool encodeDelta(std::string &out, uint32_t channel, const StockInfo &prev,
+                 int64_t prevTime, const StockInfo &info, int64_t time);
+
+// Decode a snapshot into info and time, return its channel and code, or
+// nullopt if the payload is malformed.
+std::optional<std::pair<uint32_t, std::string_view>>
+decodeSnapshot(std::string_view payload, StockInfo &info, int64_t &time);
+// Channel of a delta, to find the quote it applies to.
+std::optional<uint32_t> deltaChannel(std::string_view payload);
+// Update info and time by a delta, return false if it is malformed.
+bool applyDelta(std::string_view payload, StockInfo &info, int64_t &time);
+
+#endif // QUOTE_PROTOCOL_H
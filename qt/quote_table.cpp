@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cstring>
+
+#include "quote_table.h"
+
+#if defined(__GNUC__)
+// Four doubles per operation, lowered to SSE2/AVX/NEON by the compiler
+typedef double Double4 __attribute__((vector_size(4 * sizeof(double))));
+#endif
+
+void QuoteTable::resize(size_t n) {
+  last.resize(n, 0.0);
+  base.resize(n, 0.0);
+  diff.resize(n, 0.0);
+  pct.resize(n, 0.0);
+  high.resize(n, 0.0);
+  low.resize(n, 0.0);
+  turnover.resize(n, 0.0);
+  lastUpdate.resize(n, 0);
+  version++;
+}
+
+void QuoteTable::moveRow(size_t from, size_t to) {
+  last[to] = last[from];
+  base[to] = base[from];
+  diff[to] = diff[from];
+  pct[to] = pct[from];
+  high[to] = high[from];
+  low[to] = low[from];
+  turnover[to] = turnover[from];
+  lastUpdate[to] = lastUpdate[from];
+  version++;
+}
+
+void QuoteTable::update(size_t row, double curPrice, double basePrice,
+                        double turnover, int64_t time) {
+  if (lastUpdate[row] == 0) {
+    high[row] = curPrice;
+    low[row] = curPrice;
+  } else {
+    high[row] = std::max(high[row], curPrice);
+    low[row] = std::min(low[row], curPrice);
+  }
+  last[row] = curPrice;
+  base[row] = basePrice;
+  this->turnover[row] = turnover;
+  lastUpdate[row] = time;
+  dirty = true;
+}
+
+void QuoteTable::recompute() {
+  if (!dirty)
+    return;
+  dirty = false;
+  version++;
+  const size_t n = size();
+  const double *l = last.data();
+  const double *b = base.data();
+  double *d = diff.data();
+  double *p = pct.data();
+  size_t i = 0;
+#if defined(__GNUC__)
+  for (; i + 4 <= n; i += 4) {
+    Double4 vl, vb;
+    memcpy(&vl, l + i, sizeof(vl));
+    memcpy(&vb, b + i, sizeof(vb));
+    Double4 vd = vl - vb;
+    Double4 vp = vd / vb * 100.0;
+    memcpy(d + i, &vd, sizeof(vd));
+    memcpy(p + i, &vp, sizeof(vp));
+  }
+#endif
+  for (; i < n; i++) {
+    d[i] = l[i] - b[i];
+    p[i] = d[i] / b[i] * 100.0;
+  }
+}
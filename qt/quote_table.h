@@ -0,0 +1,69 @@
+#ifndef QUOTE_TABLE_H
+#define QUOTE_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quote of a single row, gathered from the columns of QuoteTable.
+struct Quote {
+  double last;
+  double base;
+  double diff;
+  double pct;
+  double high;
+  double low;
+  double turnover;
+  int64_t lastUpdate; // Milliseconds since epoch, 0 if pending
+
+  bool isPending() const { return lastUpdate == 0; }
+  bool isBelow() const { return diff < 0; }
+};
+
+// Structure-of-arrays quotes of the watchlist, rows match the slots of
+// StockRegistry. Raw columns are written as replies arrive, derived columns
+// (diff, pct) are recomputed in one vectorizable pass per fetch cycle, so
+// display modes only read precomputed values.
+class QuoteTable {
+public:
+  size_t size() const { return last.size(); }
+  // New rows are pending.
+  void resize(size_t n);
+  // Overwrite row to with row from, used to fill holes on erase.
+  void moveRow(size_t from, size_t to);
+
+  // Write raw columns of a row, derived columns are stale until recompute().
+  void update(size_t row, double curPrice, double basePrice, double turnover,
+              int64_t time);
+  // Recompute derived columns if any row is updated.
+  void recompute();
+  // Changes whenever recompute(), resize() or moveRow() may change a row.
+  uint64_t getVersion() const { return version; }
+
+  Quote row(size_t r) const {
+    return Quote{last[r], base[r], diff[r],     pct[r],
+                 high[r], low[r],  turnover[r], lastUpdate[r]};
+  }
+  const std::vector<double> &getLast() const { return last; }
+  const std::vector<double> &getBase() const { return base; }
+  const std::vector<double> &getDiff() const { return diff; }
+  const std::vector<double> &getPct() const { return pct; }
+  const std::vector<double> &getHigh() const { return high; }
+  const std::vector<double> &getLow() const { return low; }
+  const std::vector<double> &getTurnover() const { return turnover; }
+  const std::vector<int64_t> &getLastUpdate() const { return lastUpdate; }
+
+private:
+  std::vector<double> last;
+  std::vector<double> base;
+  std::vector<double> diff;
+  std::vector<double> pct;
+  std::vector<double> high; // Highest price seen since the first fetch
+  std::vector<double> low;  // Lowest price seen since the first fetch
+  std::vector<double> turnover;
+  std::vector<int64_t> lastUpdate;
+  bool dirty = false;
+  uint64_t version = 0;
+};
+
+#endif // QUOTE_TABLE_H
@@ -1,28 +1,12 @@
-#include <random>
-#include <string>
-
+#include "market_simulator.h"
 #include "stock_fetcher.h"
+#include "symbol_table.h"
 
-constexpr double mu = 0.01;
-constexpr double sigma = 0.02;
-constexpr double init = 800.0;
-
-double genRandom() {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  static std::normal_distribution<double> dist(mu, sigma);
-  return dist(gen);
-}
-
-double genNextVal(double curVal) { return curVal * (1 + genRandom() / 100.0); }
-
+// A symbol of the simulated market, see MarketSimulator.
 class RandomStockFetcher : public StockFetcher {
 public:
-  RandomStockFetcher(std::string stockCode) : StockFetcher(stockCode) {
-    yesterdayPrice = init;
-    openPrice = genNextVal(yesterdayPrice);
-    curPrice = openPrice;
-  }
+  RandomStockFetcher(SymbolId id)
+      : StockFetcher(id), index(MarketSimulator::instance().add(id)) {}
   ~RandomStockFetcher() = default;
 
   StockInfo fetchData() override;
@@ -30,21 +14,14 @@ public:
   static bool regist;
 
 private:
-  double curPrice;
-  double yesterdayPrice;
-  double openPrice;
+  uint32_t index; // In the simulator
 };
 
-// Core method: Fetch data once and return fields 1-7
 StockInfo RandomStockFetcher::fetchData() {
-  curPrice = genNextVal(curPrice);
-  return StockInfo{.name = "random",
-                   .curPrice = curPrice,
-                   .yesterdayPrice = yesterdayPrice,
-                   .openPrice = openPrice};
+  return MarketSimulator::instance().quote(index);
 }
 
 bool RandomStockFetcher::regist = StockFetcher::registCreator(
-    StockFetcher::Type::kRandom, [](std::string stockCode) -> StockFetcher * {
-      return new RandomStockFetcher(stockCode);
+    StockFetcher::Type::kRandom, [](SymbolId id) -> StockFetcher * {
+      return new RandomStockFetcher(id);
     });
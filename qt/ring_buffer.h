@@ -1,8 +1,10 @@
 #ifndef RING_BUFFER_H
 #define RING_BUFFER_H
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <iterator>
+#include <span>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
@@ -293,6 +295,17 @@ public:
     size_ += n;
   }
 
+  // Rotate the elements to the start of the storage and return them as one
+  // contiguous span, like boost::circular_buffer::linearize()
+  constexpr std::span<T> linearize() {
+    if (head_ != 0) {
+      std::rotate(data_.begin(), data_.begin() + head_, data_.end());
+      head_ = 0;
+      tail_ = size_ % Capacity;
+    }
+    return std::span<T>(data_.data(), size_);
+  }
+
   // Insert element at the end (rvalue reference version)
   constexpr void
   push_back(T &&value) noexcept(std::is_nothrow_move_assignable_v<T>) {
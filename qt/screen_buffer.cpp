@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string>
+
+#include "screen_buffer.h"
+
+// East Asian wide and fullwidth ranges, enough for names and symbols
+static bool isWide(char32_t ch) {
+  return (ch >= 0x1100 && ch <= 0x115F) || (ch >= 0x2E80 && ch <= 0xA4CF) ||
+         (ch >= 0xAC00 && ch <= 0xD7A3) || (ch >= 0xF900 && ch <= 0xFAFF) ||
+         (ch >= 0xFE30 && ch <= 0xFE4F) || (ch >= 0xFF00 && ch <= 0xFF60) ||
+         (ch >= 0xFFE0 && ch <= 0xFFE6) || (ch >= 0x20000 && ch <= 0x3FFFD);
+}
+
+// Decode the character at text[i] and advance i, '?' for malformed input.
+static char32_t decodeUtf8(std::string_view text, size_t &i) {
+  unsigned char lead = text[i++];
+  if (lead < 0x80)
+    return lead;
+  int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : -1;
+  if (extra < 0)
+    return U'?';
+  char32_t ch = lead & (0x3F >> extra);
+  for (int k = 0; k < extra; k++) {
+    if (i >= text.size() ||
+        (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80)
+      return U'?';
+    ch = (ch << 6) | (static_cast<unsigned char>(text[i++]) & 0x3F);
+  }
+  return ch;
+}
+
+static void encodeUtf8(char32_t ch, std::string &out) {
+  if (ch < 0x80) {
+    out += static_cast<char>(ch);
+  } else if (ch < 0x800) {
+    out += static_cast<char>(0xC0 | (ch >> 6));
+    out += static_cast<char>(0x80 | (ch & 0x3F));
+  } else if (ch < 0x10000) {
+    out += static_cast<char>(0xE0 | (ch >> 12));
+    out += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (ch & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (ch >> 18));
+    out += static_cast<char>(0x80 | ((ch >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (ch & 0x3F));
+  }
+}
+
+void ScreenBuffer::resize(int width, int height) {
+  this->width = width;
+  this->height = height;
+  front.assign(static_cast<size_t>(width) * height, Cell());
+  back.assign(front.size(), Cell());
+  full = true;
+}
+
+void ScreenBuffer::clear() { back.assign(back.size(), Cell()); }
+
+void ScreenBuffer::clearRow(int y) {
+  if (y >= 0 && y < height)
+    std::fill_n(&at(back, 0, y), width, Cell());
+}
+
+int ScreenBuffer::put(int x, int y, std::string_view text, Color color,
+                      int limit) {
+  if (y < 0 || y >= height)
+    return x;
+  limit = std::min(limit, width);
+  size_t i = 0;
+  while (i < text.size() && x < limit) {
+    char32_t ch = decodeUtf8(text, i);
+    bool wide = isWide(ch);
+    // A wide character cut by the limit is left out
+    if (wide && x + 1 >= limit)
+      break;
+    at(back, x++, y) = Cell{ch, color};
+    if (wide)
+      at(back, x++, y) = Cell{0, color};
+  }
+  return x;
+}
+
+void ScreenBuffer::flush(std::string &out) {
+  // Jumping over fewer unchanged cells is shorter than moving the cursor
+  constexpr int maxGap = 4;
+  static const std::array<std::string_view, 5> sgr = {
+      "\x1b[0m", "\x1b[0;31m", "\x1b[0;32m", "\x1b[0;90m", "\x1b[0;1m"};
+
+  auto changed = [&](int x, int y) {
+    return full || at(back, x, y) != at(front, x, y);
+  };
+  int color = -1;
+  for (int y = 0; y < height; y++) {
+    int x = 0;
+    while (x < width) {
+      if (!changed(x, y)) {
+        x++;
+        continue;
+      }
+      // Start and end on whole wide characters, the terminal erases a wide
+      // character when either half is overwritten
+      int start = x;
+      if (start > 0 &&
+          (at(back, start, y).ch == 0 || at(front, start, y).ch == 0))
+        start--;
+      int end = x + 1;
+      for (int gap = 0; end < width && gap <= maxGap; end++)
+        gap = changed(end, y) ? 0 : gap + 1;
+      while (end > x + 1 && !changed(end - 1, y))
+        end--;
+      if (end < width && at(back, end, y).ch == 0)
+        end++;
+
+      out += "\x1b[";
+      out += std::to_string(y + 1);
+      out += ';';
+      out += std::to_string(start + 1);
+      out += 'H';
+      for (int k = start; k < end; k++) {
+        const Cell &cell = at(back, k, y);
+        if (cell.ch == 0)
+          continue;
+        if (static_cast<int>(cell.color) != color) {
+          color = static_cast<int>(cell.color);
+          out += sgr[color];
+        }
+        encodeUtf8(cell.ch, out);
+      }
+      x = end;
+    }
+  }
+  if (color > 0)
+    out += sgr[0];
+  front = back;
+  full = false;
+}
@@ -0,0 +1,51 @@
+#ifndef SCREEN_BUFFER_H
+#define SCREEN_BUFFER_H
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Character grid of an ANSI terminal. A frame is drawn into the back buffer
+// and flush() emits only the cells that differ from the previous frame, so an
+// idle symbol costs no output at all.
+class ScreenBuffer {
+public:
+  enum class Color : uint8_t { kDefault = 0, kRed, kGreen, kGray, kBold };
+
+  // Resize to width x height columns, the next flush redraws everything.
+  void resize(int width, int height);
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  // Blank the back buffer, or one row of it.
+  void clear();
+  void clearRow(int y);
+  // Put UTF-8 text at column x of row y, clipped before column limit and the
+  // end of the row. East Asian wide characters take two columns. Return the
+  // column after the text.
+  int put(int x, int y, std::string_view text, Color color = Color::kDefault,
+          int limit = INT_MAX);
+  // Append the escape sequences turning the previous frame into the back
+  // buffer to out, then keep the back buffer as the previous frame.
+  void flush(std::string &out);
+
+private:
+  struct Cell {
+    char32_t ch = U' '; // 0 for the right half of a wide character
+    Color color = Color::kDefault;
+    bool operator==(const Cell &other) const = default;
+  };
+
+  int width = 0;
+  int height = 0;
+  bool full = true; // Terminal content is unknown, redraw every cell
+  std::vector<Cell> front; // Shown by the terminal
+  std::vector<Cell> back;  // Being drawn
+
+  Cell &at(std::vector<Cell> &cells, int x, int y) {
+    return cells[static_cast<size_t>(y) * width + x];
+  }
+};
+
+#endif // SCREEN_BUFFER_H
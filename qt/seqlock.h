@@ -0,0 +1,111 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEQLOCK_PAUSE() _mm_pause()
+#else
+#define SEQLOCK_PAUSE() ((void)0)
+#endif
+
+// Publishes a trivially copyable value to any number of readers. Readers
+// never block writers and never take a lock, they retry if a write overlaps
+// their copy. Concurrent writers are serialized by the sequence itself.
+// The value is stored as atomic words: word stores are release and word loads
+// acquire, so a reader that sees any new word also sees the odd sequence on its
+// recheck. That keeps the racy copy well defined without standalone fences,
+// which ThreadSanitizer does not model; on x86 these are plain moves.
+template <typename T> class SeqLock {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "SeqLock only holds trivially copyable values");
+
+public:
+  SeqLock() : seq(0) {
+    for (auto &w : words)
+      w.store(0, std::memory_order_relaxed);
+  }
+  explicit SeqLock(const T &value) : SeqLock() { store(value); }
+  SeqLock(const SeqLock &) = delete;
+  SeqLock &operator=(const SeqLock &) = delete;
+
+  // Return a consistent copy of the latest stored value.
+  T load() const {
+    T value;
+    for (;;) {
+      uint64_t begin = seq.load(std::memory_order_acquire);
+      if (begin & 1) {
+        SEQLOCK_PAUSE();
+        continue;
+      }
+      copyOut(value);
+      if (seq.load(std::memory_order_relaxed) == begin)
+        return value;
+    }
+  }
+
+  void store(const T &value) {
+    uint64_t s = lock();
+    copyIn(value);
+    unlock(s);
+  }
+
+  // Read-modify-write under the writer side, fn receives T &. Used when the
+  // new value depends on the old one, e.g. pushing to a history.
+  template <typename Fn> void update(Fn &&fn) {
+    uint64_t s = lock();
+    T value;
+    copyOut(value);
+    fn(value);
+    copyIn(value);
+    unlock(s);
+  }
+
+  // Number of completed stores, readers may use it to skip unchanged values.
+  uint64_t version() const { return seq.load(std::memory_order_acquire) / 2; }
+
+private:
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint64_t> seq; // Odd while a write is in progress
+  std::array<std::atomic<uint64_t>, kWords> words;
+
+  uint64_t lock() {
+    uint64_t s = seq.load(std::memory_order_relaxed);
+    for (;;) {
+      if (s & 1) {
+        SEQLOCK_PAUSE();
+        s = seq.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (seq.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+                                    std::memory_order_relaxed))
+        break;
+    }
+    return s;
+  }
+
+  void unlock(uint64_t s) { seq.store(s + 2, std::memory_order_release); }
+
+  void copyOut(T &value) const {
+    std::array<uint64_t, kWords> buf;
+    for (size_t i = 0; i < kWords; i++)
+      buf[i] = words[i].load(std::memory_order_acquire);
+    memcpy(static_cast<void *>(&value), buf.data(), sizeof(T));
+  }
+
+  void copyIn(const T &value) {
+    std::array<uint64_t, kWords> buf{};
+    memcpy(buf.data(), static_cast<const void *>(&value), sizeof(T));
+    for (size_t i = 0; i < kWords; i++)
+      words[i].store(buf[i], std::memory_order_release);
+  }
+};
+
+#endif // SEQLOCK_H
@@ -6,6 +6,8 @@
 
 #include "sina_fetcher.h"
 #include "stock_fetcher.h"
+#include "symbol_table.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <QNetworkRequest>
@@ -63,6 +65,7 @@ static void getValue(const std::vector<std::string_view> inputs, int idx,
 }
 
 StockInfo SinaFetcher::parseReturnInfo(std::string_view response_data) {
+  TRACE_SCOPE("SinaFetcher::parseReturnInfo");
   // Extract data between quotation marks from API response
   size_t start = response_data.find('"');
   size_t end = response_data.find('"', start + 1);
@@ -77,6 +80,8 @@ StockInfo SinaFetcher::parseReturnInfo(std::string_view response_data) {
   getValue(fields, getCurPriceIdx(), result.curPrice);
   getValue(fields, getYesterdayPriceIdx(), result.yesterdayPrice);
   getValue(fields, getOpenPriceIdx(), result.openPrice);
+  getValue(fields, getVolumeIdx(), result.volume);
+  getValue(fields, getTurnoverIdx(), result.turnover);
   getValue(fields, getNameIdx(), result.name);
   return result;
 }
@@ -95,10 +100,14 @@ private:
   int getYesterdayPriceIdx() const override final { return 2; }
 
   int getOpenPriceIdx() const override final { return 1; }
+
+  int getVolumeIdx() const override final { return 8; }
+
+  int getTurnoverIdx() const override final { return 9; }
 };
 
 // Register factory method for SinaFetcher
 bool SinaStockFetcher::regist = StockFetcher::registCreator(
-    StockFetcher::Type::kSina, [](std::string stockCode) -> StockFetcher * {
-      return new SinaStockFetcher(stockCode);
+    StockFetcher::Type::kSina, [](SymbolId id) -> StockFetcher * {
+      return new SinaStockFetcher(id);
     });
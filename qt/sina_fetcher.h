@@ -4,15 +4,17 @@
 
 #include "logger.h"
 #include "stock_fetcher.h"
+#include "symbol_table.h"
 
 #include <QNetworkRequest>
 #include <QUrl>
 
 class SinaFetcher : public NetworkFetcher {
 public:
-  SinaFetcher(std::string code)
-      : NetworkFetcher(code, getRequest(getUrl(code))) {
-    LOG(INFO) << "Creat fetcher: " << code;
+  // prefix of the code in the URL, e.g. "nf_" for futures
+  SinaFetcher(SymbolId id, std::string_view prefix = std::string_view())
+      : NetworkFetcher(id, getRequest(getUrl(symbolCode(id), prefix))) {
+    LOG(INFO) << "Creat fetcher: " << getCode();
   }
   ~SinaFetcher() = default;
 
@@ -20,11 +22,13 @@ private:
   StockInfo parseReturnInfo(std::string_view info) override final;
 
 protected:
-  // [name, curPrice, yesterdayPrice, openPrice]
+  // [name, curPrice, yesterdayPrice, openPrice, volume, turnover]
   virtual int getNameIdx() const = 0;
   virtual int getCurPriceIdx() const = 0;
   virtual int getYesterdayPriceIdx() const = 0;
   virtual int getOpenPriceIdx() const = 0;
+  virtual int getVolumeIdx() const = 0;
+  virtual int getTurnoverIdx() const = 0;
 
   static QNetworkRequest getRequest(QUrl url);
   static QUrl getUrl(std::string_view stockCode,
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "logger.h"
+#include "sparkline.h"
+
+#include <QImage>
+#include <QRect>
+
+#define DEBUG_TYPE "sparkline"
+
+#if defined(__GNUC__)
+// Four pixels per operation, lowered to SSE2/NEON by the compiler. Wider
+// vectors would change the ABI of the helpers without -mavx.
+typedef uint32_t U32x4 __attribute__((vector_size(4 * sizeof(uint32_t))));
+typedef float F32x4 __attribute__((vector_size(4 * sizeof(float))));
+#endif
+
+// x * a / 255 for each byte of a premultiplied pixel, as Qt's BYTE_MUL, for
+// single pixels and vectors of them.
+template <typename T> static inline T byteMul(T x, T a) {
+  T t = (x & 0xff00ff) * a;
+  t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+  t &= 0xff00ff;
+  x = ((x >> 8) & 0xff00ff) * a;
+  x = x + ((x >> 8) & 0xff00ff) + 0x800080;
+  x &= 0xff00ff00;
+  return x | t;
+}
+
+// Source over, src is premultiplied color scaled by coverage.
+template <typename T> static inline T blend(T dst, T color, T coverage) {
+  T src = byteMul(color, coverage);
+  return src + byteMul(dst, 255 - (src >> 24));
+}
+
+template <typename V> static inline V load(const float *p) {
+  V v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+template <typename V> static inline V vmin(V a, V b) { return a < b ? a : b; }
+template <typename V> static inline V vmax(V a, V b) { return a > b ? a : b; }
+
+// Blend color over row[0, n) with the coverage of each pixel given by
+// cov(x, zero), in [0, 1] for the pixel x or the four pixels from x,
+// where zero picks float or F32x4.
+template <typename Coverage>
+static void blendRow(uint32_t *row, int n, uint32_t color, Coverage cov) {
+  int x = 0;
+#if defined(__GNUC__)
+  for (; x + 4 <= n; x += 4) {
+    F32x4 c = cov(x, F32x4{});
+    // Skip blocks the shape does not touch, most of a row
+    bool empty = true;
+    for (int i = 0; i < 4; i++)
+      empty &= c[i] <= 0.0f;
+    if (empty)
+      continue;
+    U32x4 a = __builtin_convertvector(c * 255.0f + 0.5f, U32x4);
+    U32x4 dst;
+    memcpy(&dst, row + x, sizeof(dst));
+    dst = blend(dst, U32x4{} + color, a);
+    memcpy(row + x, &dst, sizeof(dst));
+  }
+#endif
+  for (; x < n; x++) {
+    float c = cov(x, 0.0f);
+    if (c > 0.0f)
+      row[x] = blend(row[x], color, static_cast<uint32_t>(c * 255.0f + 0.5f));
+  }
+}
+
+void drawSparkline(QImage &image, const QRect &rect,
+                   std::span<const double> values, double ub, double diff,
+                   QRgb color) {
+  if (image.format() != QImage::Format_ARGB32_Premultiplied) {
+    LOG(ERROR) << "Sparkline needs a premultiplied ARGB32 image";
+    return;
+  }
+  QRect clip = rect.intersected(image.rect());
+  const int width = rect.width();
+  const int height = rect.height();
+  if (values.size() < 2 || width < 2 || height < 1 || clip.isEmpty() ||
+      diff <= 0)
+    return;
+
+  // y of the polyline at the left edge of each column and at the right end,
+  // the points are spread evenly like QPainter's path
+  std::vector<float> edge(width + 1);
+  const double xStep = static_cast<double>(width) / (values.size() - 1);
+  for (int x = 0; x <= width; x++) {
+    double t = x / xStep;
+    size_t i = std::min(static_cast<size_t>(t), values.size() - 2);
+    double f = t - i;
+    double value = values[i] + (values[i + 1] - values[i]) * f;
+    edge[x] = (ub - value) / diff * height;
+  }
+  // Per column: the fill starts at the mean height of the line, the 1 px line
+  // covers its vertical extent across the column widened by half a pixel
+  std::vector<float> fillTop(width + 4), lineTop(width + 4),
+      lineBottom(width + 4);
+  float minFill = height, minLine = height, maxLine = 0;
+  for (int x = 0; x < width; x++) {
+    float a = edge[x], b = edge[x + 1];
+    fillTop[x] = (a + b) / 2;
+    lineTop[x] = std::min(a, b) - 0.5f;
+    lineBottom[x] = std::max(a, b) + 0.5f;
+    minFill = std::min(minFill, fillTop[x]);
+    minLine = std::min(minLine, lineTop[x]);
+    maxLine = std::max(maxLine, lineBottom[x]);
+  }
+  // Pixels right of the chart are never covered
+  std::fill(fillTop.begin() + width, fillTop.end(), float(height));
+  std::fill(lineTop.begin() + width, lineTop.end(), float(height));
+  std::fill(lineBottom.begin() + width, lineBottom.end(), float(height));
+
+  const uint32_t premul = qPremultiply(color);
+  const int left = clip.left() - rect.left();
+  const int columns = clip.width();
+  auto row = [&](int r) {
+    return reinterpret_cast<uint32_t *>(image.scanLine(rect.top() + r)) +
+           clip.left();
+  };
+  // Gradient from color at the top to transparent at half the height,
+  // interpolated premultiplied like QLinearGradient, sampled at row centers
+  const int firstRow = std::max(clip.top() - rect.top(), 0);
+  const int lastRow = std::min(clip.bottom() - rect.top() + 1, height);
+  const double gradient = height / 2.0;
+  int fillEnd = std::min<int>(std::ceil(gradient), lastRow);
+  for (int r = std::max<int>(std::floor(minFill), firstRow); r < fillEnd;
+       r++) {
+    double t = (r + 0.5) / gradient;
+    if (t >= 1.0)
+      break;
+    uint32_t rowColor =
+        byteMul(premul, static_cast<uint32_t>((1.0 - t) * 255.0 + 0.5));
+    float bottom = r + 1.0f;
+    blendRow(row(r), columns, rowColor, [&](int x, auto zero) {
+      using V = decltype(zero);
+      V c = (zero + bottom) - load<V>(&fillTop[x + left]);
+      return vmin(vmax(c, zero), zero + 1.0f);
+    });
+  }
+
+  // Line over the fill, coverage is the overlap of its span with the pixel
+  int lineEnd = std::min<int>(std::ceil(maxLine), lastRow);
+  for (int r = std::max<int>(std::floor(minLine), firstRow); r < lineEnd;
+       r++) {
+    float top = r, bottom = r + 1.0f;
+    blendRow(row(r), columns, premul, [&](int x, auto zero) {
+      using V = decltype(zero);
+      V c = vmin(load<V>(&lineBottom[x + left]), zero + bottom) -
+            vmax(load<V>(&lineTop[x + left]), zero + top);
+      return vmin(vmax(c, zero), zero + 1.0f);
+    });
+  }
+}
+
+int countDifferentPixels(const QImage &a, const QImage &b, const QRect &rect,
+                         int tolerance) {
+  QRect clip = rect.intersected(a.rect()).intersected(b.rect());
+  int count = 0;
+  for (int y = clip.top(); y <= clip.bottom(); y++) {
+    auto rowA = reinterpret_cast<const uint32_t *>(a.scanLine(y));
+    auto rowB = reinterpret_cast<const uint32_t *>(b.scanLine(y));
+    for (int x = clip.left(); x <= clip.right(); x++) {
+      for (int shift = 0; shift < 32; shift += 8) {
+        int ca = (rowA[x] >> shift) & 0xff, cb = (rowB[x] >> shift) & 0xff;
+        if (std::abs(ca - cb) > tolerance) {
+          count++;
+          break;
+        }
+      }
+    }
+  }
+  return count;
+}
@@ -0,0 +1,30 @@
+#ifndef SPARKLINE_H
+#define SPARKLINE_H
+
+#include <span>
+
+#include <QRgb>
+
+class QImage;
+class QRect;
+
+// Software renderer of the line chart: the gradient area fill under the
+// prices and an antialiased 1 px line, rasterised with vector instructions
+// straight into the scanlines of a premultiplied ARGB32 image, blended over
+// its content. Matches what QPainter draws for the same polyline closely,
+// without a paint engine. values are spread over the width of rect, ub is
+// the price at its top and diff the price range over its height.
+void drawSparkline(QImage &image, const QRect &rect,
+                   std::span<const double> values, double ub, double diff,
+                   QRgb color);
+
+// Pixels of rect where a channel of a and b, both ARGB32, differs by more
+// than tolerance, to check the rasteriser against QPainter. Known
+// differences: QPainter strokes the line as a polygon with its own
+// antialiasing, where this takes the vertical overlap of the line with each
+// pixel column, so pixels along the line differ noticeably; QPainter looks
+// the gradient up in a colour table, so the fill differs by a few levels.
+int countDifferentPixels(const QImage &a, const QImage &b, const QRect &rect,
+                         int tolerance);
+
+#endif // SPARKLINE_H
@@ -1,42 +1,33 @@
 #include <algorithm>
 #include <cstddef>
-#include <exception>
+#include <mutex>
+#include <optional>
 #include <ostream>
 
 #include "logger.h"
+#include "market_clock.h"
+#include "metrics.h"
+#include "quote_client.h"
 #include "stock.h"
 #include "stock_fetcher.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <QDateTime>
 #include <QInternal>
 
-Stock::Stock(std::string stock_code) : baseData(0.0) {
-  if (stock_code.starts_with("test")) {
-    dataFetcher = std::unique_ptr<StockFetcher>(
-        StockFetcher::create(StockFetcher::Type::kRandom, stock_code));
-  } else if (isStock(stock_code)) {
-    dataFetcher = std::unique_ptr<StockFetcher>(
-        StockFetcher::create(StockFetcher::Type::kSina, stock_code));
-  } else if (isFuture(stock_code)) {
-    dataFetcher = std::unique_ptr<StockFetcher>(StockFetcher::create(
-        StockFetcher::Type::kSinaBackwardation, stock_code));
-  }
-  try {
-    auto newData = dataFetcher->fetchData();
-    name = newData.name;
-    baseData = newData.yesterdayPrice;
-    historyData.push_back(historyData.capacity(), newData.curPrice);
-  } catch (const std::exception &e) {
-    LOG(ERROR) << "Fetch data failed, stock_code: " << stock_code
-               << ", detail error inf: " << e.what();
-    return;
-  }
+Stock::Stock(SymbolId id) : id(id), state(std::make_unique<State>()) {}
+
+static StockFetcher *createFetcher(SymbolId id) {
+  // A thin client takes every quote from the daemon
+  if (useQuoteDaemon())
+    return StockFetcher::create(StockFetcher::Type::kDaemon, id);
+  return StockFetcher::createFor(id);
 }
 
 // Check if current time is within trading hours
-bool Stock::isTradingTime() const {
-  QDateTime now = QDateTime::currentDateTime();
+bool Stock::isTradingTime() {
+  QDateTime now = MarketClock::instance().dateTime();
   int day = now.date().dayOfWeek();
 
   // Only check from Monday to Friday
@@ -53,28 +44,115 @@ bool Stock::isTradingTime() const {
   return morningSession || afternoonSession;
 }
 
-void Stock::fetchLatestData() {
-  // Do nothing during non-trading hours
-  if (!isTradingTime()) {
-    return;
+bool Stock::fetchLatestData(FetchCallback &&callback) {
+  TRACE_SCOPE("Stock::fetchLatestData");
+  // Do nothing during non-trading hours, or while the last fetch is pending
+  if (state->fetching || (!isPending() && !isTradingTime())) {
+    return false;
+  }
+  if (!dataFetcher) {
+    dataFetcher = std::unique_ptr<StockFetcher>(createFetcher(id));
+    if (!dataFetcher) {
+      LOG(ERROR) << "No fetcher for stock_code: " << getCode();
+      return false;
+    }
   }
-  auto newData = dataFetcher->fetchData();
+  state->fetching = true;
+  dataFetcher->fetchDataAsync(std::move(callback));
+  return true;
+}
+
+void Stock::finishFetch(const std::optional<StockInfo> &newData) {
+  state->fetching = false;
+  if (newData)
+    publish(*newData, MarketClock::instance().now());
+}
+
+void Stock::publish(const StockInfo &newData, int64_t time) {
+  TRACE_SCOPE("Stock::publish");
+  static metrics::Counter &quotes = metrics::counter(
+      "monitor_quotes_total", "Quotes applied to the watchlist, rate() for "
+                              "quotes per second");
+  quotes.inc();
+  StockSnapshot snapshot{.curPrice = newData.curPrice,
+                         .basePrice = newData.yesterdayPrice,
+                         .turnover = newData.turnover,
+                         .lastUpdate = time,
+                         .name = {}};
+  copyUtf8(snapshot.name, sizeof(snapshot.name), newData.name);
+  {
+    // History, indicators and quote of one stock advance together, the last
+    // quote is never older than the history
+    std::lock_guard lock(state->producer);
+    // History goes first, so a non-pending snapshot always has history
+    state->history.update([&newData](Data &history) {
+      // The first data fills the whole chart
+      if (history.empty())
+        history.push_back(history.capacity(), newData.curPrice);
+      else
+        history.push_back(newData.curPrice);
+    });
+    if (state->volumes.empty())
+      state->volumes.push_back(state->volumes.capacity(), newData.volume);
+    else
+      state->volumes.push_back(newData.volume);
+    for (size_t i = 0; i < state->indicators.size(); i++) {
+      auto &indicator = state->indicators[i];
+      indicator->push(newData.curPrice, newData.volume);
+      state->outputs[i]->store(indicator->getOutput());
+    }
+    state->quote.store(snapshot);
+  }
+}
+
+std::pair<StockSnapshot, Data> Stock::getQuoteAndHistory() const {
+  // Every publish stores the history, then the quote, so both have the same
+  // version between publishes. A history read while the quote stays at that
+  // version belongs to it.
+  for (;;) {
+    uint64_t version = state->quote.version();
+    Data history = state->history.load();
+    StockSnapshot quote = state->quote.load();
+    if (state->history.version() == version &&
+        state->quote.version() == version)
+      return {quote, std::move(history)};
+  }
+}
+
+void Stock::setIndicators(const std::vector<IndicatorSpec> &specs) {
+  std::lock_guard lock(state->producer);
+  state->indicators.clear();
+  state->outputs.clear();
+  // Replay the history with its volumes, so indicators added later line up
+  // with the chart. By index, a full ring_buffer has begin() == end().
+  Data history = state->history.load();
+  const Data &volumes = state->volumes;
+  for (const auto &spec : specs) {
+    state->indicators.emplace_back(Indicator::create(spec));
+    for (size_t i = 0; i < history.size(); i++)
+      state->indicators.back()->push(history[i], volumes[i]);
+    state->outputs.push_back(std::make_unique<SeqLock<IndicatorOutput>>(
+        state->indicators.back()->getOutput()));
+  }
+}
 
-  name = newData.name;
-  if (newData.yesterdayPrice != baseData)
-    baseData = newData.yesterdayPrice;
-  historyData.push_back(newData.curPrice);
+std::vector<IndicatorOutput> Stock::getIndicators() const {
+  std::vector<IndicatorOutput> ret;
+  ret.reserve(state->outputs.size());
+  for (const auto &output : state->outputs)
+    ret.push_back(output->load());
+  return ret;
 }
 
-std::pair<double, double> Stock::getBound() const {
-  if (historyData.empty()) { // Handle empty data case
-    return {getBaseData(), getBaseData()};
+std::pair<double, double> Stock::getBound(const Data &history) {
+  if (history.empty()) { // Handle empty data case
+    return {0.0, 0.0};
   }
 
-  double min = historyData[0], max = historyData[0];
-  for (size_t i = 0; i < historyData.size(); ++i) {
-    min = std::min(min, historyData[i]);
-    max = std::max(max, historyData[i]);
+  double min = history[0], max = history[0];
+  for (size_t i = 0; i < history.size(); ++i) {
+    min = std::min(min, history[i]);
+    max = std::max(max, history[i]);
   }
   return {min, max};
 }
@@ -1,66 +1,93 @@
 #ifndef STOCK_H
 #define STOCK_H
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
-#include <set>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "indicator.h"
 #include "ring_buffer.h"
+#include "seqlock.h"
 #include "stock_fetcher.h"
+#include "symbol_table.h"
 
 using Data = ring_buffer<double, 240>;
 
+// Fixed-size fields of a stock, published together as one snapshot.
+struct StockSnapshot {
+  double curPrice;
+  double basePrice;
+  double turnover;
+  int64_t lastUpdate; // Milliseconds since epoch, 0 if pending
+  char name[32];      // UTF-8, truncated at a character boundary
+};
+
 class Stock {
 public:
-  explicit Stock(std::string stock_code);
+  // Never touches the network, the fetcher is created by the first fetch and
+  // data is pending until it finishes.
+  explicit Stock(SymbolId id);
+  Stock(Stock &&) = default;
+  Stock &operator=(Stock &&) = default;
+
+  // No data has been fetched yet, quotes live in the QuoteTable of the owner.
+  bool isPending() const { return getSnapshot().lastUpdate == 0; }
+  bool isFetching() const { return state->fetching; }
+
+  // Readers below never block and always see a consistent state, from any
+  // thread, while producers publish. The quote and the history are separate
+  // seqlocks, read one after the other they may be a publish apart.
+  StockSnapshot getSnapshot() const { return state->quote.load(); }
+  Data getHistroy() const { return state->history.load(); }
+  // Quote and history of the same publish, retried while one is in progress.
+  std::pair<StockSnapshot, Data> getQuoteAndHistory() const;
+  // Bumped by every publish, used to skip unchanged stocks.
+  uint64_t getVersion() const { return state->history.version(); }
+  SymbolId getId() const { return id; }
+  const std::string &getCode() const { return symbolCode(id); }
+  std::string getName() const { return getSnapshot().name; }
+  // Return {min, max} of a history, {0, 0} if empty
+  static std::pair<double, double> getBound(const Data &history);
+  // Within the trading sessions of a weekday, local time.
+  static bool isTradingTime();
 
-  double getCurrentNumber() const { return historyData.back(); }
-  double getBaseData() const { return baseData; }
-  double getDifference() const { return getCurrentNumber() - getBaseData(); }
-  double getPercentage() const {
-    return getDifference() / getBaseData() * 100.0;
-  }
-  bool isBelow() const { return getDifference() < 0; }
-  const Data &getHistroy() const { return historyData; }
-  const std::string &getCode() const { return dataFetcher->getCode(); }
-  const std::string &getName() const { return name; }
-  bool operator<(const Stock &other) const {
-    return getCode() < other.getCode();
-  }
-  bool operator>(const Stock &other) const {
-    return getCode() > other.getCode();
-  }
-  bool operator==(const Stock &other) const {
-    return getCode() == other.getCode();
-  }
-  // Return {min, max}
-  std::pair<double, double> getBound() const;
+  // Indicators are replaced and read by the owner thread, their outputs are
+  // updated by publish() and read without blocking like the history.
+  void setIndicators(const std::vector<IndicatorSpec> &specs);
+  std::vector<IndicatorOutput> getIndicators() const;
   ~Stock() = default;
 
-  // Fetch new data and update
-  void fetchLatestData();
+  // Fetch new data without blocking, return false if no request is started.
+  // The callback may outlive this object if it is moved, so it must not
+  // capture it; the owner applies the result by finishFetch(). Pending stocks
+  // are fetched regardless of trading hours.
+  bool fetchLatestData(FetchCallback &&callback);
+  void finishFetch(const std::optional<StockInfo> &newData);
+  // Publish new data, may be called from any number of producer threads.
+  void publish(const StockInfo &newData, int64_t time);
 
 private:
-  double baseData; // Base value
-  std::unique_ptr<StockFetcher> dataFetcher;
-  Data historyData; // Historical data
-  std::string name;
-
-  bool isTradingTime() const;
-  // Calculate difference
-  void calculateDifference();
-  // Calculate percentage change
-  void calculatePercentage();
-};
+  // Shared between producers and readers, so it never moves with the Stock.
+  struct State {
+    SeqLock<StockSnapshot> quote;
+    SeqLock<Data> history; // Historical data
+    std::atomic<bool> fetching{false}; // A request is in flight
+    // Serializes producers of this stock, never taken by readers
+    std::mutex producer;
+    Data volumes; // Volume of each history point, guarded by producer
+    std::vector<std::unique_ptr<Indicator>> indicators;
+    std::vector<std::unique_ptr<SeqLock<IndicatorOutput>>> outputs;
+  };
 
-struct StockCmp {
-  inline bool operator()(const std::unique_ptr<Stock> &a,
-                         const std::unique_ptr<Stock> &b) const {
-    return *a < *b;
-  }
+  SymbolId id;
+  std::unique_ptr<State> state;
+  // Declared last, destroyed first, so no reply lands in a dead state
+  std::unique_ptr<StockFetcher> dataFetcher;
 };
-using StockSet = std::set<std::unique_ptr<Stock>, StockCmp>;
-using StockSetIt = StockSet::const_iterator;
 
 #endif // STOCK_H
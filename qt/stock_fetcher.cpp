@@ -1,4 +1,8 @@
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <new>
 #include <ostream>
 #include <stdexcept>
@@ -6,7 +10,9 @@
 #include <utility>
 
 #include "logger.h"
+#include "metrics.h"
 #include "stock_fetcher.h"
+#include "trace.h"
 
 #include <QByteArray>
 #include <QEventLoop>
@@ -28,20 +34,86 @@ size_t StockFetcher::writeCallback(void *contents, size_t size, size_t nmemb,
   return newLength;
 }
 
-static std::array<std::function<StockFetcher *(std::string)>,
+static std::array<std::function<StockFetcher *(SymbolId)>,
                   static_cast<int>(StockFetcher::Type::kNum)>
     creators;
 
 bool StockFetcher::registCreator(
-    Type type, std::function<StockFetcher *(std::string)> &&fn) {
+    Type type, std::function<StockFetcher *(SymbolId)> &&fn) {
   creators[static_cast<int>(type)] = std::move(fn);
   return true;
 }
 
-std::string NetworkFetcher::fetch() {
-  // Singleton QNetworkAccessManager for efficient network operations
+void StockFetcher::fetchDataAsync(FetchCallback &&callback) {
+  std::optional<StockInfo> result;
+  try {
+    result = fetchData();
+  } catch (const std::exception &e) {
+    LOG(ERROR) << "Fetch data failed, stock_code: " << getCode()
+               << ", detail error inf: " << e.what();
+  }
+  callback(std::move(result));
+}
+
+// Singleton QNetworkAccessManager for efficient network operations
+static QNetworkAccessManager &getManager() {
   static QNetworkAccessManager manager;
-  QNetworkReply *reply = manager.get(request);
+  return manager;
+}
+
+namespace {
+
+// Fetch metrics of the provider of one symbol kind
+struct FetchMetrics {
+  metrics::Counter &requests;
+  metrics::Counter &networkErrors;
+  metrics::Counter &timeouts;
+  metrics::Counter &parseErrors;
+  metrics::Histogram &latency;
+};
+
+FetchMetrics makeFetchMetrics(const char *provider) {
+  std::string labels = std::string("provider=\"") + provider + "\"";
+  auto error = [&labels](const char *cls) -> metrics::Counter & {
+    return metrics::counter("monitor_fetch_errors_total",
+                            "Failed fetches by provider and error class",
+                            labels + ",class=\"" + cls + "\"");
+  };
+  return {metrics::counter("monitor_fetch_requests_total",
+                           "Requests sent by provider", labels),
+          error("network"), error("timeout"), error("parse"),
+          metrics::histogram("monitor_fetch_latency_seconds",
+                             "Seconds from request to reply by provider",
+                             {0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5,
+                              10},
+                             labels)};
+}
+
+FetchMetrics &fetchMetrics(SymbolId id) {
+  // Network fetchers all ask sina, futures from a separate endpoint
+  static FetchMetrics stock = makeFetchMetrics("sina");
+  static FetchMetrics future = makeFetchMetrics("sina_future");
+  return symbolKind(id) == SymbolKind::kFuture ? future : stock;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int NetworkFetcher::transferTimeout = 5000;
+
+void NetworkFetcher::setFreq(int64_t freq) {
+  transferTimeout = int(std::clamp<int64_t>(freq * 3, 2000, 30000));
+}
+
+std::string NetworkFetcher::fetch() {
+  TRACE_SCOPE("NetworkFetcher::fetch");
+  request.setTransferTimeout(transferTimeout);
+  QNetworkReply *reply = getManager().get(request);
   // Execute synchronous network request using event loop
   QEventLoop loop;
   QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
@@ -66,7 +138,50 @@ StockInfo NetworkFetcher::fetchData() {
   return parseReturnInfo(result);
 }
 
+void NetworkFetcher::fetchDataAsync(FetchCallback &&callback) {
+  // All replies share one manager, so requests issued in the same loop
+  // iteration are sent in parallel.
+  request.setTransferTimeout(transferTimeout);
+  QNetworkReply *reply = getManager().get(request);
+  // Connecting, sending and waiting for the reply
+  TRACE_ASYNC_BEGIN("NetworkFetcher::request", uintptr_t(reply));
+  FetchMetrics &stats = fetchMetrics(id);
+  stats.requests.inc();
+  auto start = std::chrono::steady_clock::now();
+  QObject::connect(reply, &QNetworkReply::finished, reply,
+                   &QObject::deleteLater);
+  QObject::connect(
+      reply, &QNetworkReply::finished, context.get(),
+      [this, reply, &stats, start, callback = std::move(callback)]() {
+        TRACE_ASYNC_END("NetworkFetcher::request", uintptr_t(reply));
+        TRACE_SCOPE("NetworkFetcher::onReply");
+        stats.latency.observe(secondsSince(start));
+        std::optional<StockInfo> result;
+        bool replied = false;
+        try {
+          QNetworkReply::NetworkError error = reply->error();
+          if (error != QNetworkReply::NoError) {
+            bool timeout = error == QNetworkReply::TimeoutError ||
+                           error == QNetworkReply::OperationCanceledError;
+            (timeout ? stats.timeouts : stats.networkErrors).inc();
+            throw std::runtime_error(
+                std::string("Request failed: ")
+                    .append(reply->errorString().toStdString()));
+          }
+          replied = true;
+          result = parseReturnInfo(reply->readAll().toStdString());
+        } catch (const std::exception &e) {
+          if (replied)
+            stats.parseErrors.inc();
+          LOG(ERROR) << "Fetch data failed, stock_code: " << getCode()
+                     << ", detail error inf: " << e.what();
+        }
+        callback(std::move(result));
+      });
+}
+
 std::string gbk2utf8(std::string_view in) {
+  TRACE_SCOPE("gbk2utf8");
   QByteArray gbkData(std::string(in).c_str(), in.size());
   QTextCodec *gbkCodec = QTextCodec::codecForName("GBK");
   if (!gbkCodec) {
@@ -76,9 +191,22 @@ std::string gbk2utf8(std::string_view in) {
   return unicodeStr.toUtf8().toStdString();
 }
 
-StockFetcher *StockFetcher::create(Type type, std::string stockCode) {
+StockFetcher *StockFetcher::create(Type type, SymbolId id) {
   const auto &fn = creators[static_cast<int>(type)];
   if (!fn)
     LOG(FATAL) << "Invalid creator type";
-  return fn(stockCode);
+  return fn(id);
+}
+
+StockFetcher *StockFetcher::createFor(SymbolId id) {
+  switch (symbolKind(id)) {
+  case SymbolKind::kRandom:
+    return create(Type::kRandom, id);
+  case SymbolKind::kStock:
+    return create(Type::kSina, id);
+  case SymbolKind::kFuture:
+    return create(Type::kSinaBackwardation, id);
+  default:
+    return nullptr;
+  }
 }
@@ -2,11 +2,17 @@
 #define STOCK_FETCHER_H
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 
+#include "symbol_table.h"
+
 #include <QNetworkRequest>
+#include <QObject>
 #include <QUrl>
 
 struct StockInfo {
@@ -14,52 +20,74 @@ struct StockInfo {
   double curPrice;
   double yesterdayPrice;
   double openPrice;
+  double volume;   // Accumulated volume of the day
+  double turnover; // Accumulated turnover of the day
 };
 
+// Invoked with the fetched info, or std::nullopt if the fetch failed.
+using FetchCallback = std::function<void(std::optional<StockInfo>)>;
+
 class StockFetcher {
 public:
   enum class Type : int {
     kRandom = 0,
     kSina = 1,
     kSinaBackwardation = 2,
+    kDaemon = 3, // Thin client of the quote daemon
     kNum,
   };
-  // Constructor: Initialize stock code
-  explicit StockFetcher(std::string_view stockCode) : stockCode(stockCode) {}
+  // Constructor: Initialize stock symbol
+  explicit StockFetcher(SymbolId id) : id(id) {}
   virtual ~StockFetcher() = default;
 
   // Fetch stock data once, return stock price
   virtual StockInfo fetchData() = 0;
-  const std::string &getCode() const { return stockCode; }
+  // Fetch stock data without blocking, callback is invoked from the event loop
+  // once the reply arrives. Defaults to a synchronous fetchData().
+  virtual void fetchDataAsync(FetchCallback &&callback);
+  SymbolId getId() const { return id; }
+  const std::string &getCode() const { return symbolCode(id); }
 
-  static StockFetcher *create(Type type, std::string stockCode);
+  static StockFetcher *create(Type type, SymbolId id);
+  // Fetcher of the data source of the symbol kind, nullptr if it has none.
+  static StockFetcher *createFor(SymbolId id);
 
 protected:
   StockFetcher() {}
 
 protected:
-  std::string stockCode;
+  SymbolId id;
   static size_t writeCallback(void *contents, size_t size, size_t nmemb,
                               std::string *s);
   static bool registCreator(Type type,
-                            std::function<StockFetcher *(std::string)> &&fn);
+                            std::function<StockFetcher *(SymbolId)> &&fn);
 };
 
 class NetworkFetcher : public StockFetcher {
 public:
   StockInfo fetchData() override final;
+  void fetchDataAsync(FetchCallback &&callback) override final;
   virtual ~NetworkFetcher() = default;
   void setUrl(QUrl url) { request.setUrl(url); }
+  // Requests are aborted after a few fetch cycles of freq ms, so a stalled
+  // one cannot keep its stock fetching forever. Taken by the next request.
+  static void setFreq(int64_t freq);
 
 protected:
-  NetworkFetcher(std::string_view code, QNetworkRequest request)
-      : StockFetcher(code), request(request) {}
+  NetworkFetcher(SymbolId id, QNetworkRequest request)
+      : StockFetcher(id), request(request),
+        context(std::make_unique<QObject>()) {
+    this->request.setTransferTimeout(transferTimeout);
+  }
   // Converts GBK encoded string to UTF-8
   virtual StockInfo parseReturnInfo(std::string_view info) = 0;
 
 private:
   std::string fetch();
+  static int transferTimeout; // ms
   QNetworkRequest request;
+  // Receiver of pending replies, dropping it disconnects their callbacks.
+  std::unique_ptr<QObject> context;
 };
 
 std::string gbk2utf8(std::string_view in);
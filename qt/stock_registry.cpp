@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "market_clock.h"
+#include "metrics.h"
+#include "stock_fetcher.h"
+#include "stock_registry.h"
+
+StockRegistry::StockRegistry() {
+  metricsCollector = metrics::Registry::instance().addCollector(
+      [this](std::string &out) {
+        out += "# HELP monitor_quote_age_seconds Seconds since the last quote "
+               "of each code\n"
+               "# TYPE monitor_quote_age_seconds gauge\n";
+        int64_t now = MarketClock::instance().now();
+        for (size_t slot = 0; slot < stocks.size(); slot++) {
+          Quote quote = quoteTable.row(slot);
+          if (quote.isPending())
+            continue;
+          metrics::appendSample(
+              out, "monitor_quote_age_seconds",
+              "code=\"" + stocks[slot].getCode() + "\"",
+              (now - quote.lastUpdate) / 1000.0);
+        }
+      });
+}
+
+StockRegistry::~StockRegistry() {
+  metrics::Registry::instance().removeCollector(metricsCollector);
+}
+
+Stock *StockRegistry::find(SymbolId id) {
+  if (id >= slotOf.size() || slotOf[id] == kEmpty)
+    return nullptr;
+  return &stocks[slotOf[id]];
+}
+
+const Stock *StockRegistry::find(SymbolId id) const {
+  return const_cast<StockRegistry *>(this)->find(id);
+}
+
+bool StockRegistry::insert(SymbolId id) {
+  if (find(id))
+    return false;
+  if (id >= slotOf.size()) {
+    slotOf.resize(SymbolTable::instance().size(), kEmpty);
+    fetchedIn.resize(slotOf.size(), 0);
+  }
+
+  uint32_t slot = stocks.size();
+  stocks.emplace_back(id);
+  quoteTable.resize(stocks.size());
+  slotOf[id] = slot;
+  // Codes are only compared here, to keep the display order stable
+  const auto &code = symbolCode(id);
+  auto pos = std::lower_bound(order.begin(), order.end(), code,
+                              [this](uint32_t s, const std::string &c) {
+                                return stocks[s].getCode() < c;
+                              });
+  order.insert(pos, slot);
+  generation++;
+  return true;
+}
+
+bool StockRegistry::erase(SymbolId id) {
+  if (!find(id))
+    return false;
+  uint32_t slot = slotOf[id];
+  slotOf[id] = kEmpty;
+  // Its reply will be dropped, don't let it hold the cycle open
+  bool fetching = stocks[slot].isFetching() && fetchedIn[id] == cycle;
+  order.erase(std::find(order.begin(), order.end(), slot));
+
+  // Fill the hole with the last stock to keep storage contiguous
+  uint32_t last = stocks.size() - 1;
+  if (slot != last) {
+    slotOf[stocks[last].getId()] = slot;
+    *std::find(order.begin(), order.end(), last) = slot;
+    stocks[slot] = std::move(stocks[last]);
+    quoteTable.moveRow(last, slot);
+  }
+  stocks.pop_back();
+  quoteTable.resize(stocks.size());
+  generation++;
+  if (fetching)
+    finishReply();
+  return true;
+}
+
+void StockRegistry::fetchLatestData(std::function<void()> onUpdated) {
+  static metrics::Counter &ticks =
+      metrics::counter("monitor_ticks_total", "Fetch cycles started");
+  ticks.inc();
+  // A reply that never came must not stall every later cycle, show what the
+  // last one got and start afresh
+  if (inFlight > 0)
+    flushChanged();
+  inFlight = 0;
+  cycle++;
+  onCycleUpdated = std::move(onUpdated);
+  // Hold the cycle open while requesting, synchronous fetchers reply
+  // immediately
+  inFlight++;
+  for (auto &stock : stocks) {
+    inFlight++;
+    // Slots move on erase, so the reply looks its stock up again by id
+    bool started = stock.fetchLatestData(
+        [this, id = stock.getId(),
+         requested = cycle](std::optional<StockInfo> newData) {
+          Stock *target = find(id);
+          if (!target)
+            return;
+          target->finishFetch(newData);
+          if (newData) {
+            StockSnapshot snapshot = target->getSnapshot();
+            quoteTable.update(slotOf[id], snapshot.curPrice,
+                              snapshot.basePrice, snapshot.turnover,
+                              snapshot.lastUpdate);
+            changed.push_back(id);
+          }
+          // A late reply is shown with the current cycle, which it was
+          // never counted in
+          if (requested == cycle)
+            finishReply();
+        });
+    if (started)
+      fetchedIn[stock.getId()] = cycle;
+    else
+      inFlight--;
+  }
+  finishReply();
+}
+
+void StockRegistry::finishReply() {
+  if (--inFlight == 0)
+    flushChanged();
+}
+
+void StockRegistry::flushChanged() {
+  if (changed.empty())
+    return;
+  quoteTable.recompute();
+  if (onCycleUpdated)
+    onCycleUpdated();
+  changed.clear();
+}
@@ -0,0 +1,82 @@
+#ifndef STOCK_REGISTRY_H
+#define STOCK_REGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "quote_table.h"
+#include "stock.h"
+#include "symbol_table.h"
+
+// Owns all watched stocks in contiguous storage, indexed directly by their
+// interned symbol id, and their quotes in a QuoteTable whose rows match the
+// storage slots. Display order (sorted by code) is kept separately, so erasing
+// a stock never moves the others on screen. Insert, erase and lookup never
+// create a fetcher or touch the network.
+class StockRegistry {
+public:
+  // Exports the age of every quote to the metrics.
+  StockRegistry();
+  ~StockRegistry();
+  // Pending replies refer to the registry, so it never moves.
+  StockRegistry(const StockRegistry &) = delete;
+  StockRegistry &operator=(const StockRegistry &) = delete;
+
+  // Return false if the symbol is already registered.
+  bool insert(SymbolId id);
+  // Return false if the symbol is not registered.
+  bool erase(SymbolId id);
+  Stock *find(SymbolId id);
+  const Stock *find(SymbolId id) const;
+
+  size_t size() const { return stocks.size(); }
+  // Bumped on every insert and erase, lets views cache layouts.
+  uint64_t getGeneration() const { return generation; }
+  bool empty() const { return stocks.empty(); }
+  // Access by display position.
+  Stock &at(size_t pos) { return stocks[order[pos]]; }
+  const Stock &at(size_t pos) const { return stocks[order[pos]]; }
+  // Storage slot (row of quotes) of a display position.
+  size_t slotAt(size_t pos) const { return order[pos]; }
+  // Storage slot of a registered symbol.
+  size_t getSlot(SymbolId id) const { return slotOf[id]; }
+  const QuoteTable &quotes() const { return quoteTable; }
+
+  // Storage order, use at() for display order.
+  std::vector<Stock>::iterator begin() { return stocks.begin(); }
+  std::vector<Stock>::iterator end() { return stocks.end(); }
+  std::vector<Stock>::const_iterator begin() const { return stocks.begin(); }
+  std::vector<Stock>::const_iterator end() const { return stocks.end(); }
+
+  // Fetch all stocks in parallel. Once every reply of the cycle is applied,
+  // derived quotes are recomputed in batch and onUpdated is called if any
+  // stock changed. Replies still missing when the next cycle starts no
+  // longer hold it: what arrived is flushed then, and late replies are
+  // applied with the current cycle. Replies of erased stocks are dropped.
+  void fetchLatestData(std::function<void()> onUpdated);
+  // Symbols updated in the current cycle, valid during onUpdated.
+  const std::vector<SymbolId> &getChanged() const { return changed; }
+
+private:
+  static constexpr uint32_t kEmpty = UINT32_MAX;
+
+  std::vector<Stock> stocks;
+  std::vector<uint32_t> order;  // Display position -> slot of stocks
+  std::vector<uint32_t> slotOf; // Symbol id -> slot of stocks or kEmpty
+  QuoteTable quoteTable;
+  uint64_t generation = 0;
+  uint64_t cycle = 0;  // Fetch cycles started
+  size_t inFlight = 0; // Replies pending in the current fetch cycle
+  std::vector<uint64_t> fetchedIn; // Symbol id -> cycle of its last request
+  std::vector<SymbolId> changed;
+  std::function<void()> onCycleUpdated;
+  int metricsCollector;
+
+  void finishReply();
+  // Recompute and call onCycleUpdated if any stock changed
+  void flushChanged();
+};
+
+#endif // STOCK_REGISTRY_H
@@ -0,0 +1,90 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stock.h"
+#include "symbol_table.h"
+
+// Publishes to one stock from several producer threads while a reader checks
+// every quote and history it gets, best built with -DSANITIZER=thread, e.g.
+//   StockStress [producers] [publishes of each]
+// Exits non-zero if a read was torn or out of order.
+int main(int argc, char *argv[]) {
+  const int producers = argc > 1 ? std::atoi(argv[1]) : 4;
+  const int publishes = argc > 2 ? std::atoi(argv[2]) : 100000;
+  if (producers < 1 || publishes < 1) {
+    fprintf(stderr, "Usage: %s [producers] [publishes]\n", argv[0]);
+    return 2;
+  }
+  Stock stock(internSymbol("test0"));
+
+  // Every field is derived from the price, which names its producer and
+  // its count, so a torn read shows up as a mismatch
+  constexpr double kStride = 1e7;
+  std::atomic<int> running{producers};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&stock, &running, p, publishes]() {
+      for (int i = 1; i <= publishes; i++) {
+        double price = p * kStride + i;
+        stock.publish(StockInfo{.name = "P" + std::to_string(p),
+                                .curPrice = price,
+                                .yesterdayPrice = price,
+                                .openPrice = price,
+                                .volume = price,
+                                .turnover = 2 * price},
+                      int64_t(price));
+      }
+      running--;
+    });
+  }
+
+  size_t reads = 0, errors = 0;
+  auto check = [&errors](bool ok, const char *what) {
+    if (!ok && errors++ < 10)
+      fprintf(stderr, "Inconsistent %s\n", what);
+  };
+  auto checkQuote = [&check](const StockSnapshot &quote) {
+    if (quote.lastUpdate == 0)
+      return;
+    int p = int(quote.curPrice / kStride);
+    check(quote.basePrice == quote.curPrice &&
+              quote.turnover == 2 * quote.curPrice &&
+              quote.lastUpdate == int64_t(quote.curPrice) &&
+              quote.name == "P" + std::to_string(p),
+          "quote");
+  };
+  // Producers are serialized, the points of each rise in publish order
+  auto checkHistory = [&check, producers](const Data &history) {
+    std::vector<double> last(producers, 0.0);
+    for (size_t i = 0; i < history.size(); i++) {
+      int p = int(history[i] / kStride);
+      bool valid = p >= 0 && p < producers;
+      check(valid && history[i] >= last[p], "history");
+      if (valid)
+        last[p] = history[i];
+    }
+  };
+  do {
+    checkQuote(stock.getSnapshot());
+    checkHistory(stock.getHistroy());
+    auto [quote, history] = stock.getQuoteAndHistory();
+    checkQuote(quote);
+    check(quote.lastUpdate == 0 || history.back() == quote.curPrice,
+          "quote and history");
+    reads++;
+  } while (running > 0);
+  for (auto &thread : threads)
+    thread.join();
+
+  auto [quote, history] = stock.getQuoteAndHistory();
+  check(history.back() == quote.curPrice, "last quote");
+  check(stock.getVersion() == uint64_t(producers) * publishes, "version");
+  printf("%d producers, %d publishes each, %zu reads, %zu errors\n",
+         producers, publishes, reads, errors);
+  return errors ? 1 : 0;
+}
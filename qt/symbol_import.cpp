@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "logger.h"
+#include "symbol_master.h"
+#include "utils.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QTextCodec>
+
+// Refresh the symbol master from a downloaded list, one symbol per line:
+//   <code>,<name>[,<initials>]
+// separated by commas, tabs or spaces, e.g. "sh600000,浦发银行",
+// "600000.SH<tab>浦发银行" or "600000 浦发银行 pfyh". Codes without a market
+// get it from their digits. The list is UTF-8 or GBK; initials it lacks are
+// derived from the name.
+//   SymbolImport <list file> [master file]
+
+// GB2312 level 1 hanzi are ordered by pinyin, each letter starts at its code
+// here and ends before the next. Level 2 hanzi are ordered by radical.
+static constexpr struct {
+  uint16_t code;
+  char letter;
+} kLetterStarts[] = {
+    {0xB0A1, 'a'}, {0xB0C5, 'b'}, {0xB2C1, 'c'}, {0xB4EE, 'd'}, {0xB6EA, 'e'},
+    {0xB7A2, 'f'}, {0xB8C1, 'g'}, {0xB9FE, 'h'}, {0xBBF7, 'j'}, {0xBFA6, 'k'},
+    {0xC0AC, 'l'}, {0xC2E8, 'm'}, {0xC4C3, 'n'}, {0xC5B6, 'o'}, {0xC5BE, 'p'},
+    {0xC6DA, 'q'}, {0xC8BB, 'r'}, {0xC8F6, 's'}, {0xCBFA, 't'}, {0xCDDA, 'w'},
+    {0xCEF4, 'x'}, {0xD1B9, 'y'}, {0xD4D1, 'z'},
+};
+constexpr uint16_t kLevel1End = 0xD7FA;
+// Polyphones filed under another reading than the one of stock names
+static constexpr struct {
+  uint16_t code;
+  char letter;
+} kPolyphones[] = {
+    {0xB2D8, 'z'}, // 藏 of 西藏
+    {0xD0D0, 'h'}, // 行 of 银行
+    {0xD6D8, 'c'}, // 重 of 重庆
+};
+
+// Lowercase pinyin initials of a GBK name, letters and digits kept, e.g.
+// "*ST中珠" -> "stzz". Level 2 hanzi and symbols are skipped.
+static std::string pinyinInitials(std::string_view gbk) {
+  std::string initials;
+  for (size_t i = 0; i < gbk.size(); i++) {
+    unsigned char c = gbk[i];
+    if (c < 0x80) {
+      if (std::isalnum(c))
+        initials += static_cast<char>(std::tolower(c));
+      continue;
+    }
+    if (i + 1 == gbk.size())
+      break;
+    uint16_t code = c << 8 | static_cast<unsigned char>(gbk[++i]);
+    if (code >= 0xA3B0 && code <= 0xA3B9) { // Fullwidth digits
+      initials += static_cast<char>('0' + code - 0xA3B0);
+    } else if (code >= 0xA3C1 && code <= 0xA3DA) { // Fullwidth letters
+      initials += static_cast<char>('a' + code - 0xA3C1);
+    } else if (code >= 0xA3E1 && code <= 0xA3FA) {
+      initials += static_cast<char>('a' + code - 0xA3E1);
+    } else if (code >= kLetterStarts[0].code && code < kLevel1End) {
+      auto poly =
+          std::find_if(std::begin(kPolyphones), std::end(kPolyphones),
+                       [code](const auto &p) { return p.code == code; });
+      if (poly != std::end(kPolyphones)) {
+        initials += poly->letter;
+        continue;
+      }
+      auto it = std::upper_bound(
+          std::begin(kLetterStarts), std::end(kLetterStarts), code,
+          [](uint16_t c, const auto &start) { return c < start.code; });
+      initials += std::prev(it)->letter;
+    }
+  }
+  return initials;
+}
+
+// ASCII lowercase of field, quotes of CSV dropped.
+static std::string lowercase(std::string_view field) {
+  std::string out;
+  for (char c : field)
+    if (c != '"')
+      out += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return out;
+}
+
+// "sh600000", "SH600000", "600000.SH" or "600000" as "sh600000", empty if
+// it is none of them.
+static std::string normalizeCode(std::string_view field) {
+  std::string code = lowercase(field);
+  if (size_t dot = code.find('.'); dot != std::string::npos)
+    code = code.substr(dot + 1) + code.substr(0, dot);
+  if (code.size() == 6) {
+    // Markets by the first digits of the code
+    if (code.starts_with("92") || code[0] == '4' || code[0] == '8')
+      code = "bj" + code;
+    else if (code[0] == '6' || code[0] == '9')
+      code = "sh" + code;
+    else
+      code = "sz" + code;
+  }
+  try {
+    checkCode(code);
+  } catch (const std::exception &e) {
+    return {};
+  }
+  return isStock(code) ? code : std::string();
+}
+
+// Fields of a line, by commas or tabs if it has any, else by spaces.
+static std::vector<std::string_view> splitFields(std::string_view line) {
+  char delimiter = line.find(',') != std::string_view::npos    ? ','
+                   : line.find('\t') != std::string_view::npos ? '\t'
+                                                                : ' ';
+  std::vector<std::string_view> fields;
+  for (auto field : splitString(line, delimiter)) {
+    size_t begin = field.find_first_not_of(" \t\r");
+    if (begin != std::string_view::npos)
+      fields.push_back(field.substr(
+          begin, field.find_last_not_of(" \t\r") - begin + 1));
+  }
+  return fields;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "Usage: %s <list file> [master file]\n", argv[0]);
+    return 1;
+  }
+  std::string path = argc == 3 ? argv[2] : SymbolMaster::defaultPath();
+  std::ifstream fin(argv[1], std::ios::binary);
+  if (!fin) {
+    LOG(ERROR) << "Open " << argv[1] << " failed";
+    return 1;
+  }
+  std::string content((std::istreambuf_iterator<char>(fin)),
+                      std::istreambuf_iterator<char>());
+  if (content.starts_with("\xEF\xBB\xBF"))
+    content.erase(0, 3);
+
+  QTextCodec *gbk = QTextCodec::codecForName("GBK");
+  if (!gbk) {
+    LOG(ERROR) << "GBK codec is not available";
+    return 1;
+  }
+  QTextCodec::ConverterState state;
+  QTextCodec::codecForName("UTF-8")->toUnicode(content.data(),
+                                               content.size(), &state);
+  bool isGbk = state.invalidChars > 0;
+
+  std::vector<SymbolEntry> entries;
+  size_t skipped = 0;
+  for (auto line : splitString(content, '\n')) {
+    auto fields = splitFields(line);
+    std::string code = fields.size() >= 2 ? normalizeCode(fields[0]) : "";
+    if (code.empty()) {
+      skipped += !fields.empty();
+      continue;
+    }
+    QByteArray raw(fields[1].data(), fields[1].size());
+    QByteArray utf8 = isGbk ? gbk->toUnicode(raw).toUtf8() : raw;
+    std::string initials;
+    if (fields.size() >= 3) {
+      initials = lowercase(fields[2]);
+    } else {
+      QByteArray name =
+          isGbk ? raw : gbk->fromUnicode(QString::fromUtf8(raw));
+      initials = pinyinInitials(std::string_view(name.data(), name.size()));
+    }
+    entries.push_back({code, std::string(utf8.data(), utf8.size()),
+                       std::move(initials)});
+  }
+  if (skipped)
+    LOG(WARNING) << skipped << " lines without a valid code skipped";
+  if (entries.empty()) {
+    LOG(ERROR) << "No symbols in " << argv[1];
+    return 1;
+  }
+  size_t count = entries.size();
+  if (!writeSymbolMaster(path, std::move(entries)))
+    return 1;
+  LOG(INFO) << "Imported " << count << " symbols to " << path;
+  return 0;
+}
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <system_error>
+
+#include "logger.h"
+#include "symbol_master.h"
+#include "utils.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SYMBOL_MASTER_MMAP
+#endif
+
+namespace {
+
+struct Header {
+  static constexpr char kMagic[8] = {'S', 'Y', 'M', 'M', 'S', 'T', '0', '1'};
+
+  char magic[8];
+  uint32_t count;
+  uint32_t poolSize;
+};
+
+} // namespace
+
+struct SymbolRecord {
+  char code[8];      // e.g. sh600000, not NUL terminated
+  uint32_t name;     // Offset into the pool
+  uint32_t initials; // Offset into the pool
+  uint8_t nameSize;
+  uint8_t initialsSize;
+  uint8_t reserved[2];
+};
+
+// Indexes are stored for every key but the code, the record order
+constexpr int kStoredIndexes = 3;
+
+static size_t masterSize(uint32_t count, uint32_t poolSize) {
+  return sizeof(Header) + sizeof(SymbolRecord) * size_t(count) +
+         sizeof(uint32_t) * size_t(count) * kStoredIndexes + poolSize;
+}
+
+static std::runtime_error masterError(const std::string &what,
+                                      const std::string &path) {
+  return std::runtime_error(what + " symbol master " + path + ": " +
+                            strerror(errno));
+}
+
+SymbolMaster::SymbolMaster(const std::string &path) {
+#ifdef SYMBOL_MASTER_MMAP
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw masterError("Open", path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw masterError("Stat", path);
+  }
+  mappedSize = st.st_size;
+  if (mappedSize == 0) {
+    close(fd);
+    throw std::runtime_error("Empty symbol master " + path);
+  }
+  void *addr = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    throw masterError("Map", path);
+  data = static_cast<const char *>(addr);
+  mapped = true;
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw masterError("Open", path);
+  std::string content((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+  mappedSize = content.size();
+  char *copy = new char[mappedSize];
+  memcpy(copy, content.data(), mappedSize);
+  data = copy;
+#endif
+
+  Header header;
+  if (mappedSize < sizeof(header)) {
+    unmap();
+    throw std::runtime_error("Truncated symbol master " + path);
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, Header::kMagic, sizeof(header.magic)) != 0 ||
+      mappedSize < masterSize(header.count, header.poolSize)) {
+    unmap();
+    throw std::runtime_error("Invalid symbol master " + path);
+  }
+  count = header.count;
+  records = reinterpret_cast<const SymbolRecord *>(data + sizeof(Header));
+  const auto *index = reinterpret_cast<const uint32_t *>(records + count);
+  for (int k = 1; k < static_cast<int>(Key::kNum); k++)
+    indexes[k] = index + size_t(count) * (k - 1);
+  pool = reinterpret_cast<const char *>(index + size_t(count) * kStoredIndexes);
+  // Checked once, so lookups trust the offsets
+  for (uint32_t i = 0; i < count; i++) {
+    const SymbolRecord &r = records[i];
+    bool valid = size_t(r.name) + r.nameSize <= header.poolSize &&
+                 size_t(r.initials) + r.initialsSize <= header.poolSize;
+    for (int k = 1; valid && k < static_cast<int>(Key::kNum); k++)
+      valid = indexes[k][i] < count;
+    if (!valid) {
+      unmap();
+      throw std::runtime_error("Corrupted symbol master " + path);
+    }
+  }
+}
+
+SymbolMaster::~SymbolMaster() { unmap(); }
+
+void SymbolMaster::unmap() {
+  if (!data)
+    return;
+#ifdef SYMBOL_MASTER_MMAP
+  if (mapped)
+    munmap(const_cast<char *>(data), mappedSize);
+#endif
+  if (!mapped)
+    delete[] data;
+  data = nullptr;
+}
+
+std::string SymbolMaster::defaultPath() {
+  try {
+    return getenv<std::string>("MONITOR_SYMBOLS");
+  } catch (const std::unset_env &e) {
+    return "stock-symbols.dat";
+  }
+}
+
+const SymbolMaster *SymbolMaster::instance() {
+  static const SymbolMaster *master = []() -> const SymbolMaster * {
+    try {
+      auto *loaded = new SymbolMaster(defaultPath());
+      LOG(INFO) << "Symbol master of " << loaded->size() << " codes loaded";
+      return loaded;
+    } catch (const std::exception &e) {
+      LOG(WARNING) << e.what() << ", codes are not completed";
+      return nullptr;
+    }
+  }();
+  return master;
+}
+
+std::string_view SymbolMaster::key(uint32_t i, Key k) const {
+  const SymbolRecord &r = records[i];
+  switch (k) {
+  case Key::kCode:
+    return {r.code, sizeof(r.code)};
+  case Key::kDigits:
+    return {r.code + 2, sizeof(r.code) - 2};
+  case Key::kInitials:
+    return {pool + r.initials, r.initialsSize};
+  default:
+    return {pool + r.name, r.nameSize};
+  }
+}
+
+SymbolInfo SymbolMaster::info(uint32_t i) const {
+  return {key(i, Key::kCode), key(i, Key::kName), key(i, Key::kInitials)};
+}
+
+std::string_view SymbolMaster::name(std::string_view code) const {
+  const SymbolRecord *end = records + count;
+  const SymbolRecord *it = std::lower_bound(
+      records, end, code, [](const SymbolRecord &r, std::string_view c) {
+        return std::string_view(r.code, sizeof(r.code)) < c;
+      });
+  if (it == end || std::string_view(it->code, sizeof(it->code)) != code)
+    return {};
+  return key(static_cast<uint32_t>(it - records), Key::kName);
+}
+
+void SymbolMaster::collect(Key k, std::string_view prefix, size_t limit,
+                           std::vector<uint32_t> &out) const {
+  const uint32_t *index = indexes[static_cast<int>(k)];
+  auto record = [index](uint32_t pos) { return index ? index[pos] : pos; };
+  // Binary search over positions of the key order
+  uint32_t lo = 0, hi = count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (key(record(mid), k) < prefix)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  for (uint32_t pos = lo; pos < count && out.size() < limit; pos++) {
+    uint32_t i = record(pos);
+    if (!key(i, k).starts_with(prefix))
+      break;
+    if (std::find(out.begin(), out.end(), i) == out.end())
+      out.push_back(i);
+  }
+}
+
+std::vector<SymbolInfo> SymbolMaster::search(std::string_view query,
+                                             size_t limit) const {
+  std::vector<SymbolInfo> result;
+  if (query.empty() || limit == 0)
+    return result;
+  char lower[32];
+  bool ascii = query.size() <= sizeof(lower);
+  for (size_t i = 0; ascii && i < query.size(); i++) {
+    ascii = static_cast<unsigned char>(query[i]) < 0x80;
+    lower[i] = std::tolower(static_cast<unsigned char>(query[i]));
+  }
+
+  std::vector<uint32_t> found;
+  if (ascii) {
+    std::string_view q(lower, query.size());
+    collect(Key::kCode, q, limit, found);
+    if (std::all_of(q.begin(), q.end(), ::isdigit))
+      collect(Key::kDigits, q, limit, found);
+    else
+      collect(Key::kInitials, q, limit, found);
+  }
+  collect(Key::kName, query, limit, found);
+
+  result.reserve(found.size());
+  for (uint32_t i : found)
+    result.push_back(info(i));
+  return result;
+}
+
+bool writeSymbolMaster(const std::string &path,
+                       std::vector<SymbolEntry> entries) {
+  // Keep the last entry of each code
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const SymbolEntry &a, const SymbolEntry &b) {
+                     return a.code < b.code;
+                   });
+  std::vector<SymbolEntry> unique;
+  for (auto &entry : entries) {
+    if (entry.code.size() != sizeof(SymbolRecord::code)) {
+      LOG(WARNING) << "Skip symbol " << entry.code << ", not 8 characters";
+      continue;
+    }
+    if (!unique.empty() && unique.back().code == entry.code)
+      unique.back() = std::move(entry);
+    else
+      unique.push_back(std::move(entry));
+  }
+
+  uint32_t count = static_cast<uint32_t>(unique.size());
+  std::vector<SymbolRecord> records(count);
+  std::string pool;
+  for (uint32_t i = 0; i < count; i++) {
+    auto &entry = unique[i];
+    // Sizes are one byte, names are far shorter
+    char buf[256];
+    copyUtf8(buf, sizeof(buf), entry.name);
+    entry.name = buf;
+    entry.initials.resize(std::min<size_t>(entry.initials.size(), 255));
+
+    SymbolRecord &r = records[i];
+    memcpy(r.code, entry.code.data(), sizeof(r.code));
+    r.name = static_cast<uint32_t>(pool.size());
+    r.nameSize = static_cast<uint8_t>(entry.name.size());
+    pool += entry.name;
+    r.initials = static_cast<uint32_t>(pool.size());
+    r.initialsSize = static_cast<uint8_t>(entry.initials.size());
+    pool += entry.initials;
+  }
+
+  // Digits, initials and name orders, ties by code
+  std::vector<uint32_t> indexes[kStoredIndexes];
+  auto sortBy = [&](std::vector<uint32_t> &index, auto key) {
+    index.resize(count);
+    std::iota(index.begin(), index.end(), 0);
+    std::stable_sort(index.begin(), index.end(),
+                     [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+  };
+  sortBy(indexes[0], [&](uint32_t i) {
+    return std::string_view(unique[i].code).substr(2);
+  });
+  sortBy(indexes[1],
+         [&](uint32_t i) { return std::string_view(unique[i].initials); });
+  sortBy(indexes[2],
+         [&](uint32_t i) { return std::string_view(unique[i].name); });
+
+  Header header;
+  memcpy(header.magic, Header::kMagic, sizeof(header.magic));
+  header.count = count;
+  header.poolSize = static_cast<uint32_t>(pool.size());
+
+  std::string temp = path + ".tmp";
+  {
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(records.data()),
+              sizeof(SymbolRecord) * records.size());
+    for (const auto &index : indexes)
+      out.write(reinterpret_cast<const char *>(index.data()),
+                sizeof(uint32_t) * index.size());
+    out.write(pool.data(), pool.size());
+    if (!out.flush()) {
+      LOG(ERROR) << "Write symbol master " << temp << " failed";
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temp, path, error);
+  if (error) {
+    LOG(ERROR) << "Rename " << temp << " to " << path
+               << " failed: " << error.message();
+    std::filesystem::remove(temp, error);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,76 @@
+#ifndef SYMBOL_MASTER_H
+#define SYMBOL_MASTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Local master of all SH/SZ/BJ codes with their names and pinyin initials,
+// so codes are named and completed without a network call. The file is
+// written by SymbolImport and mapped read-only: a header, the records sorted
+// by code, one sorted index per other search key, then the strings. A search
+// is a binary search per key, a few microseconds for the whole market.
+
+struct SymbolInfo {
+  std::string_view code;     // e.g. sh600000
+  std::string_view name;     // UTF-8
+  std::string_view initials; // Lowercase pinyin initials, e.g. pfyh
+};
+
+struct SymbolRecord; // Layout in symbol_master.cpp
+
+class SymbolMaster {
+public:
+  // Map path, throw std::runtime_error if it is missing or invalid.
+  explicit SymbolMaster(const std::string &path);
+  ~SymbolMaster();
+  SymbolMaster(const SymbolMaster &) = delete;
+  SymbolMaster &operator=(const SymbolMaster &) = delete;
+
+  // Master at MONITOR_SYMBOLS, or defaultPath() if unset, loaded on first
+  // use. nullptr if it could not be loaded.
+  static const SymbolMaster *instance();
+  static std::string defaultPath();
+
+  size_t size() const { return count; }
+  // Name of code, empty if unknown.
+  std::string_view name(std::string_view code) const;
+  // At most limit symbols matching query as a prefix of the code, its six
+  // digits, the pinyin initials or the name, in that order. ASCII is case
+  // insensitive.
+  std::vector<SymbolInfo> search(std::string_view query, size_t limit) const;
+
+private:
+  enum class Key : int { kCode = 0, kDigits, kInitials, kName, kNum };
+
+  const char *data = nullptr;
+  size_t mappedSize = 0;
+  bool mapped = false; // Else data is a heap copy
+  uint32_t count = 0;
+  const SymbolRecord *records = nullptr;
+  const uint32_t *indexes[static_cast<int>(Key::kNum)] = {};
+  const char *pool = nullptr;
+
+  void unmap();
+  std::string_view key(uint32_t i, Key k) const;
+  SymbolInfo info(uint32_t i) const;
+  // Append the records with prefix of key k, skipping ones already in out
+  void collect(Key k, std::string_view prefix, size_t limit,
+               std::vector<uint32_t> &out) const;
+};
+
+struct SymbolEntry {
+  std::string code;
+  std::string name;
+  std::string initials;
+};
+
+// Write entries as a master to path, through a temp file renamed over it so
+// processes mapping the old one keep reading it. Later duplicates of a code
+// win. Return false and log on failure.
+bool writeSymbolMaster(const std::string &path,
+                       std::vector<SymbolEntry> entries);
+
+#endif // SYMBOL_MASTER_H
@@ -0,0 +1,58 @@
+#include <mutex>
+#include <utility>
+
+#include "symbol_table.h"
+#include "utils.h"
+
+static SymbolKind getKind(std::string_view code) {
+  if (code.starts_with("test"))
+    return SymbolKind::kRandom;
+  if (isStock(code))
+    return SymbolKind::kStock;
+  if (isFuture(code))
+    return SymbolKind::kFuture;
+  return SymbolKind::kUnknown;
+}
+
+SymbolTable &SymbolTable::instance() {
+  static SymbolTable table;
+  return table;
+}
+
+SymbolId SymbolTable::intern(std::string_view code) {
+  SymbolId id = lookup(code);
+  if (id != kInvalidSymbol)
+    return id;
+
+  std::unique_lock lock(mutex);
+  // Interned by another thread after the lookup
+  auto it = ids.find(code);
+  if (it != ids.end())
+    return it->second;
+  id = entries.size();
+  const auto &entry =
+      entries.emplace_back(Entry{std::string(code), getKind(code)});
+  ids.emplace(entry.code, id);
+  return id;
+}
+
+SymbolId SymbolTable::lookup(std::string_view code) const {
+  std::shared_lock lock(mutex);
+  auto it = ids.find(code);
+  return it == ids.end() ? kInvalidSymbol : it->second;
+}
+
+const std::string &SymbolTable::code(SymbolId id) const {
+  std::shared_lock lock(mutex);
+  return entries[id].code;
+}
+
+SymbolKind SymbolTable::kind(SymbolId id) const {
+  std::shared_lock lock(mutex);
+  return entries[id].kind;
+}
+
+size_t SymbolTable::size() const {
+  std::shared_lock lock(mutex);
+  return entries.size();
+}
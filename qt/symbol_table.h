@@ -0,0 +1,64 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Dense id of an interned code, usable as an index of per-symbol arrays.
+using SymbolId = uint32_t;
+constexpr SymbolId kInvalidSymbol = UINT32_MAX;
+
+enum class SymbolKind : uint8_t {
+  kUnknown = 0,
+  kStock = 1,  // sh/sz stock or index
+  kFuture = 2, // IH/IF/IC/IM basis, e.g. IF-Front
+  kRandom = 3, // test*
+};
+
+// Interns each code once, so the rest of the pipeline compares and indexes
+// symbols by integer. Ids are allocated from 0 and never reused; codes and
+// kinds stay valid for the whole process. Thread safe.
+class SymbolTable {
+public:
+  static SymbolTable &instance();
+
+  // Return the id of code, interning it if needed.
+  SymbolId intern(std::string_view code);
+  // Return kInvalidSymbol if code is not interned.
+  SymbolId lookup(std::string_view code) const;
+
+  const std::string &code(SymbolId id) const;
+  SymbolKind kind(SymbolId id) const;
+  // Upper bound of all ids.
+  size_t size() const;
+
+private:
+  SymbolTable() = default;
+
+  struct Entry {
+    std::string code;
+    SymbolKind kind;
+  };
+  mutable std::shared_mutex mutex;
+  std::deque<Entry> entries; // Stable references, keys below point into it
+  std::unordered_map<std::string_view, SymbolId> ids;
+};
+
+inline SymbolId internSymbol(std::string_view code) {
+  return SymbolTable::instance().intern(code);
+}
+
+inline const std::string &symbolCode(SymbolId id) {
+  return SymbolTable::instance().code(id);
+}
+
+inline SymbolKind symbolKind(SymbolId id) {
+  return SymbolTable::instance().kind(id);
+}
+
+#endif // SYMBOL_TABLE_H
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "display_mode.h"
+#include "quote_table.h"
+#include "stock.h"
+#include "stock_registry.h"
+#include "symbol_table.h"
+#include "text_cache.h"
+#include "trace.h"
+
+#include <QColor>
+#include <QInternal>
+#include <QPainter>
+#include <QPen>
+#include <QPointF>
+#include <QRect>
+#include <QRegion>
+#include <QStaticText>
+#include <QString>
+#include <QtGlobal>
+
+// Compact table of the whole watchlist. Only rows inside the viewport are
+// laid out and painted, and the text of each row is cached in QStaticText
+// until its quote changes, so thousands of rows scroll and sort smoothly.
+class TableMode final : public DisplayMode {
+public:
+  std::pair<int64_t, int64_t> calculateWindowSize(int64_t desktopWidth,
+                                                  int64_t desktoHeight,
+                                                  int64_t stockNum) override;
+  void paint(QPainter *painter, int64_t width, int64_t height,
+             const StockRegistry &stocks, size_t pos) override;
+  QRegion dirtyRegion(const StockRegistry &stocks,
+                      const std::vector<SymbolId> &changed, int64_t width,
+                      int64_t height, size_t pos) override;
+  bool scroll(int64_t rows) override;
+  bool click(int64_t x, int64_t y, int64_t width, int64_t height) override;
+
+  static bool regist;
+
+private:
+  enum class Column : int { kCode = 0, kName, kLast, kPct, kNum };
+  static constexpr int rowHeight = 18;
+  static constexpr int maxVisibleRows = 25;
+  static constexpr uint32_t kNoRow = UINT32_MAX;
+  // Left edge of each column in percent of width, and its right edge
+  static constexpr std::array<int, static_cast<int>(Column::kNum) + 1>
+      columnEdges = {0, 30, 55, 78, 100};
+
+  struct RowText {
+    int64_t lastUpdate = -1; // Quote the text is built from
+    bool below = false;
+    std::array<QStaticText, static_cast<int>(Column::kNum)> cells;
+  };
+
+  Column sortColumn = Column::kCode;
+  bool descending = false;
+  uint64_t generation = UINT64_MAX;
+  std::vector<SymbolId> rows;   // Symbols in table order
+  std::vector<uint32_t> rowOf;  // Symbol id -> row or kNoRow
+  std::vector<RowText> texts;   // Indexed by symbol id
+  TextCache fonts;
+  int64_t top = 0;              // First visible row
+  int64_t visibleRows = 0;
+
+  bool syncRows(const StockRegistry &stocks);
+  bool sortRows(const StockRegistry &stocks);
+  void clampTop();
+  const RowText &rowText(const StockRegistry &stocks, SymbolId id);
+  static int64_t columnX(Column column, int64_t width) {
+    return columnEdges[static_cast<int>(column)] * width / 100;
+  }
+  static inline int64_t calDisplayNum(int64_t totalNum) {
+    return std::clamp(totalNum, int64_t(1), int64_t(maxVisibleRows));
+  }
+};
+
+std::pair<int64_t, int64_t>
+TableMode::calculateWindowSize(int64_t desktopWidth, int64_t desktoHeight,
+                               int64_t stockNum) {
+  int64_t width = qMax(desktopWidth / 6, int64_t(250));
+  // One extra row for the header
+  return {width, rowHeight * (calDisplayNum(stockNum) + 1)};
+}
+
+// Rebuild rows after the watchlist changed, return true if it did.
+bool TableMode::syncRows(const StockRegistry &stocks) {
+  if (generation == stocks.getGeneration())
+    return false;
+  generation = stocks.getGeneration();
+  rows.clear();
+  rows.reserve(stocks.size());
+  for (size_t pos = 0; pos < stocks.size(); pos++)
+    rows.push_back(stocks.at(pos).getId());
+  if (texts.size() < SymbolTable::instance().size())
+    texts.resize(SymbolTable::instance().size());
+  sortRows(stocks);
+  clampTop();
+  return true;
+}
+
+// Sort rows by the sort column and refresh rowOf, return true if the order
+// changed. Rows are in code order already, pending quotes sort last.
+bool TableMode::sortRows(const StockRegistry &stocks) {
+  bool changed = false;
+  if (sortColumn == Column::kLast || sortColumn == Column::kPct) {
+    const auto &values = sortColumn == Column::kLast ? stocks.quotes().getLast()
+                                                     : stocks.quotes().getPct();
+    const auto &lastUpdate = stocks.quotes().getLastUpdate();
+    // Gather keys once, instead of chasing slots in the comparator
+    std::vector<std::pair<double, SymbolId>> keys;
+    keys.reserve(rows.size());
+    for (SymbolId id : rows) {
+      size_t slot = stocks.getSlot(id);
+      double key = descending ? -values[slot] : values[slot];
+      keys.emplace_back(lastUpdate[slot] == 0 ? HUGE_VAL : key, id);
+    }
+    std::stable_sort(keys.begin(), keys.end(),
+                     [](const auto &a, const auto &b) {
+                       return a.first < b.first;
+                     });
+    for (size_t i = 0; i < rows.size(); i++) {
+      changed |= rows[i] != keys[i].second;
+      rows[i] = keys[i].second;
+    }
+  } else {
+    std::vector<SymbolId> byCode;
+    byCode.reserve(stocks.size());
+    for (size_t pos = 0; pos < stocks.size(); pos++)
+      byCode.push_back(stocks.at(pos).getId());
+    if (descending)
+      std::reverse(byCode.begin(), byCode.end());
+    changed = byCode != rows;
+    rows = std::move(byCode);
+  }
+
+  if (rowOf.size() < SymbolTable::instance().size())
+    rowOf.resize(SymbolTable::instance().size(), kNoRow);
+  std::fill(rowOf.begin(), rowOf.end(), kNoRow);
+  for (size_t i = 0; i < rows.size(); i++)
+    rowOf[rows[i]] = i;
+  return changed;
+}
+
+void TableMode::clampTop() {
+  int64_t maxTop = std::max(int64_t(rows.size()) - visibleRows, int64_t(0));
+  top = std::clamp(top, int64_t(0), maxTop);
+}
+
+const TableMode::RowText &TableMode::rowText(const StockRegistry &stocks,
+                                             SymbolId id) {
+  RowText &text = texts[id];
+  Quote quote = stocks.quotes().row(stocks.getSlot(id));
+  if (text.lastUpdate == quote.lastUpdate)
+    return text;
+  text.lastUpdate = quote.lastUpdate;
+  text.below = !quote.isPending() && quote.isBelow();
+
+  auto &cells = text.cells;
+  for (auto &cell : cells)
+    cell.setPerformanceHint(QStaticText::AggressiveCaching);
+  cells[static_cast<int>(Column::kCode)].setText(
+      QString::fromStdString(symbolCode(id)));
+  if (quote.isPending()) {
+    for (int c = static_cast<int>(Column::kName);
+         c < static_cast<int>(Column::kNum); c++)
+      cells[c].setText("--");
+    return text;
+  }
+  const auto name = stocks.find(id)->getName();
+  cells[static_cast<int>(Column::kName)].setText(
+      QString::fromUtf8(name.data(), name.size()));
+  cells[static_cast<int>(Column::kLast)].setText(
+      QString::number(quote.last, 'f', quote.last < 10 ? 3 : 2));
+  QString pct = QString::number(quote.pct, 'f', 2) + "%";
+  if (quote.pct >= 0)
+    pct = "+" + pct;
+  cells[static_cast<int>(Column::kPct)].setText(pct);
+  return text;
+}
+
+void TableMode::paint(QPainter *painter, int64_t width, int64_t height,
+                      const StockRegistry &stocks, size_t pos) {
+  TRACE_SCOPE("TableMode::paint");
+  constexpr int alpha = 255 * 0.6;
+  static const QColor redColor = QColor(255, 0, 0, alpha);
+  static const QColor greenColor = QColor(0, 255, 0, alpha);
+  static const QColor headerColor = QColor(200, 200, 200, alpha);
+  static const std::array<QStaticText, static_cast<int>(Column::kNum)> header =
+      {QStaticText("Code"), QStaticText("Name"), QStaticText("Last"),
+       QStaticText("Chg%")};
+
+  visibleRows = height / rowHeight - 1;
+  syncRows(stocks);
+  clampTop();
+
+  QRect clip(0, 0, width, height);
+  if (painter->hasClipping())
+    clip = painter->clipBoundingRect().toAlignedRect();
+
+  painter->setFont(fonts.pixelFont(rowHeight - 5));
+  painter->setBrush(Qt::NoBrush);
+
+  // Numbers are right aligned, text left aligned
+  auto drawCell = [&](const QStaticText &cell, Column column, int64_t y) {
+    int64_t left = columnX(column, width) + 2;
+    if (column == Column::kLast || column == Column::kPct) {
+      int64_t right = columnX(static_cast<Column>(static_cast<int>(column) + 1),
+                              width) - 2;
+      left = right - cell.size().width();
+    }
+    painter->drawStaticText(QPointF(left, y + 2), cell);
+  };
+
+  if (clip.top() < rowHeight) {
+    painter->setPen(QPen(headerColor));
+    for (int c = 0; c < static_cast<int>(Column::kNum); c++)
+      drawCell(header[c], static_cast<Column>(c), 0);
+    painter->drawLine(0, rowHeight - 1, width, rowHeight - 1);
+  }
+
+  // Only rows intersecting the clip are laid out and drawn
+  int64_t first = std::max(int64_t(clip.top()) / rowHeight - 1, int64_t(0));
+  int64_t last = std::min<int64_t>(clip.bottom() / rowHeight, visibleRows);
+  for (int64_t r = first; r < last && top + r < int64_t(rows.size()); r++) {
+    const RowText &text = rowText(stocks, rows[top + r]);
+    painter->setPen(QPen(text.below ? greenColor : redColor));
+    int64_t y = (r + 1) * rowHeight;
+    for (int c = 0; c < static_cast<int>(Column::kNum); c++)
+      drawCell(text.cells[c], static_cast<Column>(c), y);
+  }
+}
+
+QRegion TableMode::dirtyRegion(const StockRegistry &stocks,
+                               const std::vector<SymbolId> &changed,
+                               int64_t width, int64_t height, size_t pos) {
+  bool reordered = syncRows(stocks);
+  if (sortColumn == Column::kLast || sortColumn == Column::kPct)
+    reordered |= sortRows(stocks);
+  if (reordered)
+    return QRegion(0, 0, width, height);
+
+  QRegion region;
+  for (SymbolId id : changed) {
+    if (id >= rowOf.size() || rowOf[id] == kNoRow)
+      continue;
+    int64_t r = int64_t(rowOf[id]) - top;
+    if (r >= 0 && r < visibleRows)
+      region += QRect(0, (r + 1) * rowHeight, width, rowHeight);
+  }
+  return region;
+}
+
+bool TableMode::scroll(int64_t rows) {
+  int64_t oldTop = top;
+  top += rows;
+  clampTop();
+  return top != oldTop;
+}
+
+// Clicking a header sorts by its column, clicking again reverses the order.
+bool TableMode::click(int64_t x, int64_t y, int64_t width, int64_t height) {
+  if (y >= rowHeight)
+    return false;
+  Column column = Column::kCode;
+  for (int c = 0; c < static_cast<int>(Column::kNum); c++) {
+    if (x >= columnX(static_cast<Column>(c), width))
+      column = static_cast<Column>(c);
+  }
+  // Names are not sortable, they share the code order
+  if (column == Column::kName)
+    column = Column::kCode;
+  if (column == sortColumn) {
+    descending = !descending;
+  } else {
+    sortColumn = column;
+    descending = column != Column::kCode;
+  }
+  // Force resort on next paint
+  generation = UINT64_MAX;
+  top = 0;
+  return true;
+}
+
+bool TableMode::regist = DisplayMode::registCreator(
+    DisplayMode::Type::kTable, []() -> DisplayMode * { return new TableMode; });
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "config_parser.h"
+#include "market_clock.h"
+#include "quote_table.h"
+#include "stock.h"
+#include "stock_fetcher.h"
+#include "symbol_table.h"
+#include "terminal_dashboard.h"
+#include "utils.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QObject>
+#include <QString>
+#include <QtGlobal>
+
+#ifdef Q_OS_UNIX
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+// Alternate screen with a hidden cursor while running
+static constexpr std::string_view enterScreen = "\x1b[?1049h\x1b[?25l";
+static constexpr std::string_view leaveScreen = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+// Descriptor of the terminal, read by the signal handler
+static int ttyFd = -1;
+
+static std::pair<int, int> terminalSize() {
+#ifdef Q_OS_UNIX
+  winsize size;
+  if (ioctl(ttyFd, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 &&
+      size.ws_row > 0)
+    return {size.ws_col, size.ws_row};
+#endif
+  return {80, 24};
+}
+
+#ifdef Q_OS_UNIX
+// Interrupted, restore the terminal with async-signal-safe calls only
+static void onSignal(int sig) {
+  ssize_t ret = ::write(ttyFd, leaveScreen.data(), leaveScreen.size());
+  (void)ret;
+  _exit(128 + sig);
+}
+#endif
+
+TerminalDashboard::TerminalDashboard(const ConfigData &config,
+                                     const QString &configPath)
+    : alerts(config.freq), config(config) {
+  NetworkFetcher::setFreq(config.freq);
+  for (const auto &code : config.codes) {
+    stocks.insert(code);
+    auto it = config.indicators.find(code);
+    if (it != config.indicators.end())
+      stocks.find(code)->setIndicators(it->second);
+  }
+  for (const auto &rule : config.alerts)
+    alerts.addRule(rule);
+  if (!configPath.isEmpty())
+    watcher = std::make_unique<ConfigWatcher>(
+        configPath,
+        [this](ConfigData next) { onConfigChanged(std::move(next)); });
+  // Logs go to stdout and stderr, draw on the controlling terminal so they
+  // can be redirected without losing the dashboard
+#ifdef Q_OS_UNIX
+  tty = fopen("/dev/tty", "w");
+#endif
+  if (!tty)
+    tty = stdout;
+  ttyFd = fileno(tty);
+#ifdef Q_OS_UNIX
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::signal(SIGHUP, onSignal);
+#endif
+  write(enterScreen);
+  render({});
+
+  QObject::connect(&updateTimer, &QTimer::timeout,
+                   [this]() { fetchLatestData(); });
+  QObject::connect(&resizeTimer, &QTimer::timeout, [this]() {
+    if (terminalSize() != std::pair(screen.getWidth(), screen.getHeight()))
+      render({});
+  });
+  MarketClock::instance().start(updateTimer, config.freq);
+  resizeTimer.start(resizeInterval);
+  fetchLatestData();
+}
+
+TerminalDashboard::~TerminalDashboard() {
+  write(leaveScreen);
+  if (tty != stdout)
+    fclose(tty);
+}
+
+void TerminalDashboard::fetchLatestData() {
+  stocks.fetchLatestData([this]() {
+    alerts.evaluate(stocks, stocks.getChanged());
+    render(stocks.getChanged());
+  });
+}
+
+void TerminalDashboard::onConfigChanged(ConfigData next) {
+  ConfigDiff diff = diffConfig(config, next);
+  applyConfig(diff, next, stocks, alerts);
+  config = std::move(next);
+  if (diff.freq)
+    MarketClock::instance().start(updateTimer, config.freq);
+  if (diff.watchlist())
+    render({});
+  // Only the added stocks are pending
+  if (!diff.added.empty())
+    fetchLatestData();
+}
+
+void TerminalDashboard::render(const std::vector<SymbolId> &changed) {
+  auto [width, height] = terminalSize();
+  bool all = false;
+  if (width != screen.getWidth() || height != screen.getHeight()) {
+    screen.resize(width, height);
+    all = true;
+  }
+  if (generation != stocks.getGeneration()) {
+    generation = stocks.getGeneration();
+    all = true;
+  }
+  if (all)
+    screen.clear();
+
+  if (marked.size() < SymbolTable::instance().size())
+    marked.resize(SymbolTable::instance().size());
+  for (SymbolId id : changed)
+    marked[id] = true;
+
+  drawHeader();
+  // The last row tells how many stocks do not fit
+  size_t rows = std::max(height - 1, 0);
+  size_t shown = stocks.size();
+  if (shown > rows)
+    shown = rows > 0 ? rows - 1 : 0;
+  for (size_t pos = 0; pos < shown; pos++) {
+    const Stock &stock = stocks.at(pos);
+    if (all || marked[stock.getId()])
+      drawRow(pos + 1, stock, stocks.slotAt(pos));
+  }
+  if (all && shown < stocks.size()) {
+    std::string more = "+" + std::to_string(stocks.size() - shown) + " more";
+    screen.put(0, shown + 1, more, ScreenBuffer::Color::kGray);
+  }
+
+  for (SymbolId id : changed)
+    marked[id] = false;
+
+  out.clear();
+  screen.flush(out);
+  write(out);
+}
+
+void TerminalDashboard::drawHeader() {
+  using Color = ScreenBuffer::Color;
+  screen.clearRow(0);
+  screen.put(0, 0, "Code", Color::kBold);
+  screen.put(nameX, 0, "Name", Color::kBold);
+  screen.put(pctX - 5, 0, "Last", Color::kBold);
+  screen.put(trendX - 5, 0, "Chg%", Color::kBold);
+  screen.put(trendX, 0, "Trend", Color::kBold);
+  QByteArray time =
+      MarketClock::instance().dateTime().toString("HH:mm:ss").toUtf8();
+  screen.put(screen.getWidth() - int(time.size()), 0,
+             std::string_view(time.data(), time.size()), Color::kGray);
+}
+
+void TerminalDashboard::drawRow(int y, const Stock &stock, size_t slot) {
+  using Color = ScreenBuffer::Color;
+  screen.clearRow(y);
+  Quote quote = stocks.quotes().row(slot);
+  screen.put(0, y, stock.getCode(), Color::kDefault, nameX - 1);
+  if (quote.isPending()) {
+    screen.put(nameX, y, "--", Color::kGray);
+    return;
+  }
+  Color color = quote.isBelow() ? Color::kGreen : Color::kRed;
+  const auto name = stock.getName();
+  screen.put(nameX, y, name, color, lastX - 1);
+
+  // Right aligned, ending one column before the next
+  char buf[32];
+  auto last =
+      formatNumber(buf, sizeof(buf), quote.last, quote.last < 10 ? 3 : 2);
+  screen.put(pctX - 1 - int(last.size()), y, last, color);
+  auto pct =
+      formatNumber(buf, sizeof(buf), quote.pct, 2, quote.pct >= 0, "%");
+  screen.put(trendX - 1 - int(pct.size()), y, pct, color);
+  drawSparkline(trendX, y, stock, color);
+}
+
+// One block per column, the last price of each bucket of history scaled
+// between its low and high.
+void TerminalDashboard::drawSparkline(int x, int y, const Stock &stock,
+                                      ScreenBuffer::Color color) {
+  static const std::array<std::string_view, 8> blocks = {
+      "▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+  int columns = screen.getWidth() - x;
+  Data history = stock.getHistroy();
+  size_t n = history.size();
+  if (columns <= 0 || n == 0)
+    return;
+  int count = std::min<size_t>(columns, n);
+  auto [low, high] = Stock::getBound(history);
+  double span = high - low;
+  for (int k = 0; k < count; k++) {
+    double value = history[(k + 1) * n / count - 1];
+    int level = span > 0 ? std::lround((value - low) / span * 7) : 3;
+    screen.put(x + k, y, blocks[level], color);
+  }
+}
+
+void TerminalDashboard::write(std::string_view text) {
+  fwrite(text.data(), 1, text.size(), tty);
+  fflush(tty);
+}
@@ -0,0 +1,64 @@
+#ifndef TERMINAL_DASHBOARD_H
+#define TERMINAL_DASHBOARD_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alert_engine.h"
+#include "config_watcher.h"
+#include "screen_buffer.h"
+#include "stock_registry.h"
+
+#include <QString>
+#include <QTimer>
+
+class Stock;
+
+// Watchlist as an ANSI terminal dashboard, one row per stock with a
+// sparkline of its history. Needs only QtCore and QtNetwork, so it runs over
+// SSH on hosts without a display. Rows are redrawn only for the stocks of a
+// fetch cycle, and only the cells that changed reach the terminal.
+class TerminalDashboard {
+public:
+  // Reloads the config when configPath changes, if given.
+  explicit TerminalDashboard(const ConfigData &config,
+                             const QString &configPath = {});
+  // Restores the terminal.
+  ~TerminalDashboard();
+  TerminalDashboard(const TerminalDashboard &) = delete;
+  TerminalDashboard &operator=(const TerminalDashboard &) = delete;
+
+private:
+  // Left edge of each column, numbers are right aligned before the next one
+  static constexpr int nameX = 10, lastX = 22, pctX = 31, trendX = 41;
+  // Terminal size is polled, a resize shows up within this interval
+  static constexpr int resizeInterval = 500; // ms
+
+  StockRegistry stocks;
+  AlertEngine alerts;
+  ConfigData config; // The watchlist is built from
+  std::unique_ptr<ConfigWatcher> watcher;
+  ScreenBuffer screen;
+  uint64_t generation = UINT64_MAX; // Of stocks, as last drawn
+  QTimer updateTimer;
+  QTimer resizeTimer;
+  FILE *tty = nullptr;
+  std::string out;          // Reused output of a flush
+  std::vector<bool> marked; // Symbol id -> changed in the current cycle
+
+  void fetchLatestData();
+  void onConfigChanged(ConfigData next);
+  // Redraw all rows if the size or watchlist changed, else only the rows of
+  // changed, then write the difference to the terminal.
+  void render(const std::vector<SymbolId> &changed);
+  void drawHeader();
+  void drawRow(int y, const Stock &stock, size_t slot);
+  void drawSparkline(int x, int y, const Stock &stock,
+                     ScreenBuffer::Color color);
+  void write(std::string_view text);
+};
+
+#endif // TERMINAL_DASHBOARD_H
@@ -0,0 +1,29 @@
+#include <fstream>
+#include <optional>
+
+#include "config_parser.h"
+#include "metrics_server.h"
+#include "terminal_dashboard.h"
+
+#include <QCoreApplication>
+#include <QString>
+
+// Headless entry point, the watchlist is shown in the terminal.
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+
+  ConfigData config;
+  QString configPath;
+
+  if (argc == 2) {
+    std::ifstream fin(argv[1]);
+    auto configIn = parseConfig(fin);
+    if (configIn.has_value())
+      config = *configIn;
+    configPath = QString::fromLocal8Bit(argv[1]);
+  }
+  TerminalDashboard dashboard(config, configPath);
+  startMetricsServer();
+
+  return app.exec();
+}
@@ -0,0 +1,55 @@
+#include <utility>
+
+#include "text_cache.h"
+
+#include <QPainter>
+#include <QPointF>
+#include <QSizeF>
+#include <QString>
+#include <QTransform>
+
+const QFont &TextCache::font(int pointSize) {
+  auto it = fonts.find(pointSize);
+  if (it == fonts.end())
+    it = fonts.emplace(pointSize, QFont("Arial Narrow", pointSize, QFont::Bold))
+             .first;
+  return it->second;
+}
+
+const QFont &TextCache::pixelFont(int pixelSize) {
+  auto it = pixelFonts.find(pixelSize);
+  if (it == pixelFonts.end()) {
+    QFont font("Arial Narrow");
+    font.setPixelSize(pixelSize);
+    font.setBold(true);
+    it = pixelFonts.emplace(pixelSize, std::move(font)).first;
+  }
+  return it->second;
+}
+
+const QStaticText &TextCache::text(std::string_view str, int pointSize) {
+  key.assign(reinterpret_cast<const char *>(&pointSize), sizeof(pointSize));
+  key.append(str);
+  auto it = texts.find(key);
+  if (it != texts.end())
+    return it->second;
+
+  if (texts.size() >= maxTexts)
+    texts.clear();
+  QStaticText text(QString::fromUtf8(str.data(), str.size()));
+  text.setTextFormat(Qt::PlainText);
+  text.setPerformanceHint(QStaticText::AggressiveCaching);
+  text.prepare(QTransform(), font(pointSize));
+  return texts.emplace(key, std::move(text)).first->second;
+}
+
+void TextCache::drawCentered(QPainter *painter, std::string_view str,
+                             int pointSize, int x, int y, int width,
+                             int height) {
+  const QStaticText &cached = text(str, pointSize);
+  QSizeF size = cached.size();
+  painter->setFont(font(pointSize));
+  painter->drawStaticText(QPointF(x + (width - size.width()) / 2,
+                                  y + (height - size.height()) / 2),
+                          cached);
+}
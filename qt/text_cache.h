@@ -0,0 +1,38 @@
+#ifndef TEXT_CACHE_H
+#define TEXT_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <QFont>
+#include <QStaticText>
+
+class QPainter;
+
+// Fonts and laid out text of display modes, owned by one mode and used from
+// the GUI thread. Values repeat across frames and stocks, so once a text is
+// cached drawing it skips shaping, and only changed values are laid out.
+class TextCache {
+public:
+  // Bold "Arial Narrow" of a point size, created once per size.
+  const QFont &font(int pointSize);
+  // The same in a pixel size, for text sized to fit a cell.
+  const QFont &pixelFont(int pixelSize);
+  // Text laid out in font(pointSize).
+  const QStaticText &text(std::string_view str, int pointSize);
+  // Same placement as drawText(x, y, width, height, Qt::AlignCenter, str).
+  void drawCentered(QPainter *painter, std::string_view str, int pointSize,
+                    int x, int y, int width, int height);
+
+private:
+  // Prices churn, drop everything once this many texts are cached
+  static constexpr size_t maxTexts = 4096;
+  std::unordered_map<int, QFont> fonts;
+  std::unordered_map<int, QFont> pixelFonts;
+  std::unordered_map<std::string, QStaticText> texts;
+  std::string key; // Reused lookup key: point size, then text
+};
+
+#endif // TEXT_CACHE_H
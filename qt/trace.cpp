@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "logger.h"
+#include "trace.h"
+#include "utils.h"
+
+namespace {
+
+struct Event {
+  const char *name;
+  int64_t start;
+  int64_t dur;  // Complete spans
+  uint64_t id;  // Async spans
+  char phase;   // 'X' complete, 'b'/'e' async begin/end
+};
+
+// Latest events of one thread. The owner appends without locks, a dump
+// copies the ring and drops whatever the owner overwrote meanwhile. Fields
+// are atomics so the racy copy stays defined, loaded with acquire so the
+// head read after them is not moved before; on x86 these are plain moves.
+struct ThreadBuffer {
+  static constexpr uint64_t kCapacity = 1 << 15; // A power of two
+
+  struct Slot {
+    std::atomic<const char *> name;
+    std::atomic<int64_t> start;
+    std::atomic<int64_t> dur;
+    std::atomic<uint64_t> id;
+    std::atomic<char> phase;
+  };
+
+  explicit ThreadBuffer(int tid) : tid(tid), slots(new Slot[kCapacity]) {}
+
+  void append(const Event &event) {
+    uint64_t i = head.load(std::memory_order_relaxed);
+    Slot &slot = slots[i & (kCapacity - 1)];
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.start.store(event.start, std::memory_order_relaxed);
+    slot.dur.store(event.dur, std::memory_order_relaxed);
+    slot.id.store(event.id, std::memory_order_relaxed);
+    slot.phase.store(event.phase, std::memory_order_relaxed);
+    head.store(i + 1, std::memory_order_release);
+  }
+
+  void copy(std::vector<Event> &events) const {
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t first = end > kCapacity ? end - kCapacity : 0;
+    size_t base = events.size();
+    for (uint64_t i = first; i < end; i++) {
+      const Slot &slot = slots[i & (kCapacity - 1)];
+      events.push_back({slot.name.load(std::memory_order_acquire),
+                        slot.start.load(std::memory_order_acquire),
+                        slot.dur.load(std::memory_order_acquire),
+                        slot.id.load(std::memory_order_acquire),
+                        slot.phase.load(std::memory_order_acquire)});
+    }
+    // Events from first up to the one being written now may be torn
+    uint64_t now = head.load(std::memory_order_relaxed);
+    uint64_t valid = now >= kCapacity ? now - kCapacity + 1 : 0;
+    if (valid > first) {
+      size_t torn = std::min<uint64_t>(valid - first, end - first);
+      events.erase(events.begin() + base, events.begin() + base + torn);
+    }
+  }
+
+  const int tid;
+  std::unique_ptr<Slot[]> slots;
+  std::atomic<uint64_t> head{0};
+};
+
+// Buffers of all threads that traced, kept after their thread exits.
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+  static Registry &instance() {
+    static Registry *registry = new Registry;
+    return *registry;
+  }
+};
+
+ThreadBuffer &threadBuffer() {
+  thread_local ThreadBuffer *buffer = []() {
+    Registry &registry = Registry::instance();
+    std::lock_guard lock(registry.mutex);
+    int tid = static_cast<int>(registry.buffers.size()) + 1;
+    registry.buffers.push_back(std::make_unique<ThreadBuffer>(tid));
+    return registry.buffers.back().get();
+  }();
+  return *buffer;
+}
+
+} // namespace
+
+namespace trace {
+
+int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void complete(const char *name, int64_t start, int64_t dur) {
+  threadBuffer().append({name, start, dur, 0, 'X'});
+}
+
+void asyncBegin(const char *name, uint64_t id) {
+  threadBuffer().append({name, now(), 0, id, 'b'});
+}
+
+void asyncEnd(const char *name, uint64_t id) {
+  threadBuffer().append({name, now(), 0, id, 'e'});
+}
+
+void dump(std::ostream &out) {
+  Registry &registry = Registry::instance();
+  std::lock_guard lock(registry.mutex);
+  std::vector<Event> events;
+  char line[256];
+  const char *sep = "";
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (const auto &buffer : registry.buffers) {
+    events.clear();
+    buffer->copy(events);
+    for (const Event &event : events) {
+      // Microseconds with nanosecond decimals
+      double ts = event.start / 1000.0;
+      if (event.phase == 'X')
+        snprintf(line, sizeof(line),
+                 "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                 "\"pid\":1,\"tid\":%d}",
+                 sep, event.name, ts, event.dur / 1000.0, buffer->tid);
+      else
+        snprintf(line, sizeof(line),
+                 "%s\n{\"name\":\"%s\",\"cat\":\"async\",\"ph\":\"%c\","
+                 "\"id\":\"0x%" PRIx64 "\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                 sep, event.name, event.phase, event.id, ts, buffer->tid);
+      out << line;
+      sep = ",";
+    }
+  }
+  out << "\n]}\n";
+}
+
+std::string dumpToFile() {
+  std::string path = "stock-monitor-trace.json";
+  try {
+    path = getenv<std::string>("MONITOR_TRACE_FILE");
+  } catch (const std::unset_env &e) {
+  }
+  std::ofstream out(path);
+  if (out)
+    dump(out);
+  if (!out) {
+    LOG(ERROR) << "Write trace to " << path << " failed";
+    return {};
+  }
+  LOG(INFO) << "Trace written to " << path;
+  return path;
+}
+
+} // namespace trace
@@ -0,0 +1,59 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Span tracing of the tick pipeline, compiled in with -DMONITOR_TRACE (the
+// TRACE option of CMake) and to nothing otherwise. Each thread records into
+// its own ring of the latest events without locks, dump() writes them in the
+// Chrome trace event format, opened by chrome://tracing and Perfetto.
+// Span names must be string literals.
+
+namespace trace {
+
+// Steady clock in nanoseconds.
+int64_t now();
+
+// A span of the calling thread from start, lasting dur nanoseconds.
+void complete(const char *name, int64_t start, int64_t dur);
+// Spans that end in another callback, e.g. a network request, matched by id.
+void asyncBegin(const char *name, uint64_t id);
+void asyncEnd(const char *name, uint64_t id);
+
+// Records the span of the enclosing scope.
+class Scope {
+public:
+  explicit Scope(const char *name) : name(name), start(now()) {}
+  ~Scope() { complete(name, start, now() - start); }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  const char *name;
+  int64_t start;
+};
+
+// Write the recorded events of all threads as JSON.
+void dump(std::ostream &out);
+// Write them to MONITOR_TRACE_FILE, or stock-monitor-trace.json if unset.
+// Return the path, or an empty string on failure.
+std::string dumpToFile();
+
+} // namespace trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef MONITOR_TRACE
+#define TRACE_SCOPE(name) trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_ASYNC_BEGIN(name, id) trace::asyncBegin(name, id)
+#define TRACE_ASYNC_END(name, id) trace::asyncEnd(name, id)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_ASYNC_BEGIN(name, id) ((void)0)
+#define TRACE_ASYNC_END(name, id) ((void)0)
+#endif
+
+#endif // TRACE_H
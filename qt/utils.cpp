@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <stdexcept>
 #include <string>
@@ -25,12 +27,53 @@ std::vector<std::string_view> splitString(std::string_view s, char delimiter) {
   return tokens;
 }
 
+std::string_view formatNumber(char *buf, size_t size, double value,
+                              int precision, bool plus,
+                              std::string_view suffix) {
+  char *begin = buf;
+  char *end = buf + size - suffix.size();
+  if (plus)
+    *buf++ = '+';
+  auto [ptr, ec] =
+      std::to_chars(buf, end, value, std::chars_format::fixed, precision);
+  if (ec != std::errc())
+    return "--";
+  memcpy(ptr, suffix.data(), suffix.size());
+  return std::string_view(begin, ptr + suffix.size() - begin);
+}
+
+std::string_view shortName(std::string_view name, char *buf, size_t size) {
+  // Start of each of the first four characters
+  size_t starts[4];
+  size_t count = 0;
+  for (size_t i = 0; i < name.size() && count < 4; i++) {
+    if ((static_cast<unsigned char>(name[i]) & 0xC0) != 0x80)
+      starts[count++] = i;
+  }
+  if (count < 4)
+    return name;
+  size_t len = std::min(starts[2], size - 3);
+  memcpy(buf, name.data(), len);
+  memcpy(buf + len, "...", 3);
+  return std::string_view(buf, len + 3);
+}
+
+void copyUtf8(char *dst, size_t size, std::string_view src) {
+  size_t len = std::min(src.size(), size - 1);
+  if (len < src.size()) {
+    while (len > 0 && (static_cast<unsigned char>(src[len]) & 0xC0) == 0x80)
+      len--;
+  }
+  memcpy(dst, src.data(), len);
+  dst[len] = '\0';
+}
+
 void checkCode(std::string_view code) {
   if (isStock(code)) {
     if (code.size() != 8)
       throw std::invalid_argument(
           "Stock code length must be 8 characters (e.g., sh600000, "
-          "sz000001)");
+          "sz000001, bj830799)");
     code = code.substr(2);
     if (std::any_of(code.begin(), code.end(),
                     [](const char c) { return !std::isdigit(c); }))
@@ -41,19 +84,20 @@ void checkCode(std::string_view code) {
           "Future code must be split name and type with - (e.g., IC-Front, "
           "IF-Next)");
     code = code.substr(3);
-    if (!(code == "Front" || code == "Next"))
+    if (!(code == "Front" || code == "Next" || code == "Month" ||
+          code == "NextMonth" || code == "Quarter" || code == "NextQuarter"))
       throw std::invalid_argument(
-          "Future code type only support Front/Next - (e.g., IH-Front, "
-          "IM-Next)");
+          "Future code type only support Front/Next/Month/NextMonth/Quarter/"
+          "NextQuarter - (e.g., IH-Front, IM-NextMonth)");
   } else {
     throw std::invalid_argument(
-        "code must start with sh/sz(stock) or IH/IF/IC/IM(future)");
+        "code must start with sh/sz/bj(stock) or IH/IF/IC/IM(future)");
   }
 }
 
 template <typename T> T getenv(std::string_view name) {
   const char *env_value = std::getenv(name.data());
-  if (env_value)
+  if (!env_value)
     throw std::unset_env(std::string("unset env ") + name.data());
 
   if constexpr (std::is_same_v<T, bool>) {
@@ -1,5 +1,6 @@
 #ifndef UTILS_H
 #define UTILS_H
+#include <cstddef>
 #include <stdexcept>
 #include <string_view>
 #include <vector>
@@ -7,7 +8,8 @@
 std::vector<std::string_view> splitString(std::string_view s, char delimiter);
 
 inline static bool isStock(std::string_view code) {
-  return (code.starts_with("sh") || code.starts_with("sz"));
+  return code.starts_with("sh") || code.starts_with("sz") ||
+         code.starts_with("bj");
 }
 
 inline static bool isFuture(std::string_view code) {
@@ -17,6 +19,20 @@ inline static bool isFuture(std::string_view code) {
 
 void checkCode(std::string_view code);
 
+// Format value with a fixed precision into buf, prefixed by '+' if plus and
+// followed by suffix, without allocating. Return the formatted text in buf.
+std::string_view formatNumber(char *buf, size_t size, double value,
+                              int precision, bool plus = false,
+                              std::string_view suffix = {});
+
+// Name shortened for narrow columns: the first two characters and "..." if it
+// has four or more, cut at UTF-8 character boundaries.
+std::string_view shortName(std::string_view name, char *buf, size_t size);
+
+// Copy src into dst of size bytes, NUL terminated, cut at a UTF-8 character
+// boundary if it does not fit.
+void copyUtf8(char *dst, size_t size, std::string_view src);
+
 namespace std {
 class unset_env : public std::runtime_error {
 public:
@@ -1,10 +1,19 @@
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <iterator>
 #include <set>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "config_dialog.h"
 #include "config_parser.h"
-#include "stock.h"
+#include "market_clock.h"
+#include "metrics.h"
+#include "stock_fetcher.h"
+#include "stock_registry.h"
+#include "trace.h"
 #include "widget.h"
 
 #include <QAction>
@@ -15,6 +24,8 @@
 #include <QMetaObject>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QPaintEvent>
+#include <QWheelEvent>
 #include <QtGlobal>
 
 #ifdef QT6_OR_NEWER
@@ -35,24 +46,34 @@ static inline std::pair<int, int> getDesktopSize() {
 }
 #endif
 
-Widget::RollingDisplayState::RollingDisplayState() {}
-Widget::RollingDisplayState::RollingDisplayState(
-    const std::vector<std::string> &codes) {
-  for (const auto &code : codes) {
-    stocks.insert(std::make_unique<Stock>(code));
+Widget::RollingDisplayState::RollingDisplayState(const ConfigData &config)
+    : curPos(0) {
+  for (const auto &code : config.codes) {
+    stocks.insert(code);
+    auto it = config.indicators.find(code);
+    if (it != config.indicators.end())
+      stocks.find(code)->setIndicators(it->second);
   }
-  curIt = stocks.cbegin();
 }
 
 void Widget::RollingDisplayState::next() {
-  if (++curIt == stocks.cend())
-    curIt = stocks.cbegin();
+  if (++curPos >= stocks.size())
+    curPos = 0;
 }
 
 Widget::~Widget() {}
-Widget::Widget(const ConfigData &config, QWidget *parent)
-    : QWidget(parent), m_dragging(false),
-      dispalyType(DisplayMode::Type::kLineChart) {
+Widget::Widget(const ConfigData &config, const QString &configPath,
+               QWidget *parent)
+    : QWidget(parent), m_dragging(false), m_clicking(false),
+      dispalyType(DisplayMode::Type::kLineChart), state(config),
+      alerts(config.freq), config(config) {
+  NetworkFetcher::setFreq(config.freq);
+  for (const auto &rule : config.alerts)
+    alerts.addRule(rule);
+  if (!configPath.isEmpty())
+    watcher = std::make_unique<ConfigWatcher>(
+        configPath,
+        [this](ConfigData next) { onConfigChanged(std::move(next)); });
   // Set window properties: borderless, no taskbar icon, transparent background,
   // always on top
   setWindowFlags(Qt::FramelessWindowHint | Qt::Tool | Qt::WindowStaysOnTopHint);
@@ -62,18 +83,24 @@ Widget::Widget(const ConfigData &config, QWidget *parent)
         DisplayMode::create(static_cast<DisplayMode::Type>(i)));
   }
 
-  // Create data manager
-  state = RollingDisplayState(config.codes);
-  connect(this, &Widget::dataUpdated, this, &Widget::onDataUpdated);
   connect(&updateTimer, &QTimer::timeout, this, &Widget::fetchLatestData);
-  connect(&rollingTimer, &QTimer::timeout, this, &Widget::onDataUpdated);
-  updateTimer.start(config.freq);
+  connect(&rollingTimer, &QTimer::timeout, this, &Widget::onRolling);
+  frameTimer.setSingleShot(true);
+  connect(&frameTimer, &QTimer::timeout, this, &Widget::onFrame);
+  MarketClock::instance().start(updateTimer, config.freq);
+  resetRolling();
+  // Stocks are pending until the first fetch, run it once the window is shown
+  QTimer::singleShot(0, this, &Widget::fetchLatestData);
 
   // Create right-click menu items
   actions[static_cast<int>(MenuItemEnum::kShowLineChartPos)] =
       std::make_unique<QAction>("Show Line Chart", this);
   actions[static_cast<int>(MenuItemEnum::kShowDataOnlyPos)] =
       std::make_unique<QAction>("Show Data Only", this);
+  actions[static_cast<int>(MenuItemEnum::kShowTablePos)] =
+      std::make_unique<QAction>("Show Table", this);
+  actions[static_cast<int>(MenuItemEnum::kShowHeatmapPos)] =
+      std::make_unique<QAction>("Show Heatmap", this);
   actions[static_cast<int>(MenuItemEnum::kConfigPos)] =
       std::make_unique<QAction>("Config", this);
   actions[static_cast<int>(MenuItemEnum::kExitPos)] =
@@ -83,6 +110,10 @@ Widget::Widget(const ConfigData &config, QWidget *parent)
           &QAction::triggered, this, &Widget::onShowLineChart);
   connect(actions[static_cast<int>(MenuItemEnum::kShowDataOnlyPos)].get(),
           &QAction::triggered, this, &Widget::onShowOnlyData);
+  connect(actions[static_cast<int>(MenuItemEnum::kShowTablePos)].get(),
+          &QAction::triggered, this, &Widget::onShowTable);
+  connect(actions[static_cast<int>(MenuItemEnum::kShowHeatmapPos)].get(),
+          &QAction::triggered, this, &Widget::onShowHeatmap);
   connect(actions[static_cast<int>(MenuItemEnum::kConfigPos)].get(),
           &QAction::triggered, this, &Widget::onConfig);
   connect(actions[static_cast<int>(MenuItemEnum::kExitPos)].get(),
@@ -97,13 +128,14 @@ void Widget::updateWindowSize() {
 }
 
 void Widget::fetchLatestData() {
-  for (auto &it : state.stocks) {
-    it->fetchLatestData();
-  }
-  if (!needRolling()) {
-    // Emit update.
-    emit dataUpdated();
-  }
+  // Requests of all stocks are in flight together, the rows changed by their
+  // replies are repainted with the next frame.
+  state.stocks.fetchLatestData([this]() {
+    alerts.evaluate(state.stocks, state.stocks.getChanged());
+    scheduleRepaint(displayMode[static_cast<int>(dispalyType)]->dirtyRegion(
+        state.stocks, state.stocks.getChanged(), width(), height(),
+        state.curPos));
+  });
 }
 
 void Widget::setScaledSize() {
@@ -114,22 +146,48 @@ void Widget::setScaledSize() {
   setFixedSize(finalWidth, finalHeight);
 }
 
+// Paint time of each display mode
+static metrics::Histogram &paintTime(DisplayMode::Type type) {
+  static const auto histograms = []() {
+    constexpr const char *names[] = {"line_chart", "data_only", "table",
+                                     "heatmap"};
+    static_assert(std::size(names) ==
+                  static_cast<size_t>(DisplayMode::Type::kNum));
+    std::array<metrics::Histogram *, std::size(names)> all;
+    for (size_t i = 0; i < all.size(); i++)
+      all[i] = &metrics::histogram(
+          "monitor_paint_seconds", "Seconds per paint by display mode",
+          {0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.066},
+          std::string("mode=\"") + names[i] + "\"");
+    return all;
+  }();
+  return *histograms[static_cast<int>(type)];
+}
+
 void Widget::paintEvent(QPaintEvent *event) {
-  Q_UNUSED(event);
+  TRACE_SCOPE("Widget::paintEvent");
+  if (state.stocks.empty())
+    return;
 
   QPainter painter(this);
   painter.setRenderHint(QPainter::Antialiasing);
+  // Let display modes skip what is outside the exposed region
+  painter.setClipRegion(event->region());
 
+  auto start = std::chrono::steady_clock::now();
   displayMode[static_cast<int>(dispalyType)]->paint(&painter, width(), height(),
-                                                    state.stocks, state.curIt);
-  if (needRolling())
-    state.next();
+                                                    state.stocks, state.curPos);
+  paintTime(dispalyType)
+      .observe(std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count());
 }
 
 void Widget::mousePressEvent(QMouseEvent *event) {
   if (event->button() == Qt::LeftButton) {
     m_dragging = true;
     m_dragStartPosition = event->pos();
+    m_clicking = true;
   }
   QWidget::mousePressEvent(event);
 }
@@ -137,6 +195,8 @@ void Widget::mousePressEvent(QMouseEvent *event) {
 void Widget::mouseMoveEvent(QMouseEvent *event) {
   if (m_dragging) {
     QPoint delta = event->pos() - m_dragStartPosition;
+    if (delta.manhattanLength() >= QApplication::startDragDistance())
+      m_clicking = false;
     move(mapToParent(delta));
   }
   QWidget::mouseMoveEvent(event);
@@ -145,15 +205,32 @@ void Widget::mouseMoveEvent(QMouseEvent *event) {
 void Widget::mouseReleaseEvent(QMouseEvent *event) {
   if (event->button() == Qt::LeftButton) {
     m_dragging = false;
+    // A click without dragging goes to the display mode
+    if (m_clicking &&
+        displayMode[static_cast<int>(dispalyType)]->click(
+            event->pos().x(), event->pos().y(), width(), height()))
+      scheduleRepaint(rect());
   }
   QWidget::mouseReleaseEvent(event);
 }
 
+void Widget::wheelEvent(QWheelEvent *event) {
+  // One notch is 120, scroll 3 rows per notch
+  int64_t rows = -event->angleDelta().y() / 40;
+  if (rows != 0 && displayMode[static_cast<int>(dispalyType)]->scroll(rows))
+    scheduleRepaint(rect());
+  event->accept();
+}
+
 void Widget::contextMenuEvent(QContextMenuEvent *event) {
   QMenu menu(this);
   for (auto &action : actions) {
     menu.addAction(action.get());
   }
+#ifdef MONITOR_TRACE
+  // Spans of the latest ticks, for chrome://tracing or Perfetto
+  menu.addAction("Save Trace", []() { trace::dumpToFile(); });
+#endif
   menu.exec(event->globalPos());
 }
 
@@ -161,9 +238,28 @@ void Widget::onShowLineChart() { switchTo<DisplayMode::Type::kLineChart>(); }
 
 void Widget::onShowOnlyData() { switchTo<DisplayMode::Type::kDataOnly>(); }
 
-void Widget::onDataUpdated() {
-  // Refresh interface when data is updated
-  update();
+void Widget::onShowTable() { switchTo<DisplayMode::Type::kTable>(); }
+
+void Widget::onShowHeatmap() { switchTo<DisplayMode::Type::kHeatmap>(); }
+
+void Widget::onRolling() {
+  state.next();
+  scheduleRepaint(rect());
+}
+
+// Collect region into the next frame, so data, rolling and input arriving
+// together cost one repaint.
+void Widget::scheduleRepaint(const QRegion &region) {
+  if (region.isEmpty())
+    return;
+  dirty += region;
+  if (!frameTimer.isActive())
+    frameTimer.start(frameInterval);
+}
+
+void Widget::onFrame() {
+  update(dirty);
+  dirty = QRegion();
 }
 
 void Widget::onConfig() {
@@ -174,29 +270,53 @@ void Widget::onConfig() {
 
     // Erase stock.
     for (const auto &code : deleted) {
-      auto it = state.stocks.find(std::make_unique<Stock>(code));
-      if (it != state.stocks.end()) {
-        state.stocks.erase(it);
-      }
+      state.stocks.erase(code);
+      config.indicators.erase(code);
     }
+    std::erase_if(config.codes,
+                  [&](SymbolId id) { return deleted.count(id) != 0; });
 
     // Insert stock.
     for (const auto &code : added) {
-      state.stocks.insert(std::make_unique<Stock>(code));
+      if (state.stocks.insert(code))
+        config.codes.push_back(code);
     }
+    std::sort(config.codes.begin(), config.codes.end());
 
-    // Update iter.
-    state.curIt = state.stocks.begin();
+    // The reload of this save finds nothing new
+    if (watcher)
+      watcher->saveCodes(deleted, added);
+
+    // Update position.
+    state.curPos = 0;
 
     // Refresh UI.
     resetRolling();
     updateWindowSize();
-    update();
+    scheduleRepaint(rect());
     fetchLatestData();
-    emit dataUpdated();
   }
 }
 
+void Widget::onConfigChanged(ConfigData next) {
+  ConfigDiff diff = diffConfig(config, next);
+  applyConfig(diff, next, state.stocks, alerts);
+  config = std::move(next);
+  if (diff.freq)
+    MarketClock::instance().start(updateTimer, config.freq);
+  if (diff.watchlist()) {
+    if (state.curPos >= state.stocks.size())
+      state.curPos = 0;
+    resetRolling();
+    updateWindowSize();
+  }
+  if (diff.watchlist() || !diff.indicators.empty())
+    scheduleRepaint(rect());
+  // Only the added stocks are pending
+  if (!diff.added.empty())
+    fetchLatestData();
+}
+
 void Widget::onExit() {
   // Exit application
   qApp->quit();
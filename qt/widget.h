@@ -1,31 +1,38 @@
 #ifndef WIDGET_H
 #define WIDGET_H
 #include <array>
+#include <cstddef>
 #include <memory>
-#include <string>
 #include <vector>
 
+#include "alert_engine.h"
+#include "config_watcher.h"
 #include "display_mode.h"
-#include "stock.h"
+#include "stock_registry.h"
+#include "symbol_table.h"
 
 #include <QMetaObject>
 #include <QPoint>
+#include <QRegion>
 #include <QString>
 #include <QTimer>
 #include <QWidget>
 
 class QAction;
-class ConfigData;
 class QContextMenuEvent;
 class QMouseEvent;
 class QObject;
 class QPaintEvent;
+class QWheelEvent;
 
 class Widget : public QWidget {
   Q_OBJECT
 
 public:
-  explicit Widget(const ConfigData &config, QWidget *parent = nullptr);
+  // Reloads the config when configPath changes and saves the edits of the
+  // config dialog to it, if given.
+  explicit Widget(const ConfigData &config, const QString &configPath = {},
+                  QWidget *parent = nullptr);
   ~Widget() override;
 
 private:
@@ -34,51 +41,62 @@ private:
   void fetchLatestData();
   bool needRolling() const;
   void resetRolling();
+  void scheduleRepaint(const QRegion &region);
+  void onConfigChanged(ConfigData next);
 
 protected:
   void paintEvent(QPaintEvent *event) override;
   void mousePressEvent(QMouseEvent *event) override;
   void mouseMoveEvent(QMouseEvent *event) override;
   void mouseReleaseEvent(QMouseEvent *event) override;
+  void wheelEvent(QWheelEvent *event) override;
   void
   contextMenuEvent(QContextMenuEvent *event) override; // Right-click menu event
   template <DisplayMode::Type type> void switchTo() {
     dispalyType = type;
     resetRolling();
     updateWindowSize();
-    update();
+    scheduleRepaint(rect());
   }
 
 private slots:
-  void onDataUpdated();
+  void onRolling(); // Show the next stocks
+  void onFrame();   // Repaint what changed since the last frame
   void onShowLineChart(); // Show line chart
   void onShowOnlyData();  // Show data only
+  void onShowTable();     // Show table
+  void onShowHeatmap();   // Show heatmap
   void onConfig();        // Config
   void onExit();          // Exit
 
-signals:
-  // Emitted when data is updated
-  void dataUpdated();
-
 private:
   struct RollingDisplayState {
-    RollingDisplayState();
-    explicit RollingDisplayState(const std::vector<std::string> &codes);
+    explicit RollingDisplayState(const ConfigData &config);
     void next();
-    StockSet stocks;
-    StockSetIt curIt;
+    StockRegistry stocks;
+    size_t curPos; // Display position of the first shown stock
   };
 
   bool m_dragging;
+  bool m_clicking; // Pressed without dragging yet
   DisplayMode::Type dispalyType; // Flag for showing line chart
   RollingDisplayState state;
+  AlertEngine alerts;
+  ConfigData config; // The watchlist is built from
+  std::unique_ptr<ConfigWatcher> watcher;
   QTimer updateTimer;  // Timer for periodic updates
   QTimer rollingTimer; // Timer for periodic updates
+  QTimer frameTimer;   // Coalesces repaints, one per frame at most
   QPoint m_dragStartPosition;
-  // Menu item {"Show line chart", "Show data only", "Config", "Exit"}
+  QRegion dirty; // Changed since the last frame
+  static constexpr int frameInterval = 16; // ms
+  // Menu item {"Show line chart", "Show data only", "Show table",
+  // "Show heatmap", "Config", "Exit"}
   enum class MenuItemEnum : int {
     kShowLineChartPos = 0,
     kShowDataOnlyPos,
+    kShowTablePos,
+    kShowHeatmapPos,
     kConfigPos,
     kExitPos,
     kNum